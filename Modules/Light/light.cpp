@@ -1 +1,39 @@
 #include "light.hpp"
+#include <algorithm>
+
+void Light::sampleIndirectVPLs(
+    const std::vector<Vec3f>& positions, const std::vector<Vec3f>& normals, const std::vector<Vec3f>& fluxes, int samples
+) {
+    indirect_vpls.clear();
+    if (samples <= 0 || fluxes.empty()) {
+        return;
+    }
+    // 1. Cumulative distribution of the texels, proportional to their flux
+    std::vector<double> cdf(fluxes.size());
+    double total = 0;
+    for (size_t i = 0; i < fluxes.size(); i++) {
+        total += fluxes[i].sum();
+        cdf[i] = total;
+    }
+    if (total <= 0) {
+        return;
+    }
+
+    // 2. Systematic sampling: the distribution is split into num_sets * samples equal strata,
+    //    set s takes the strata s, s + num_sets, s + 2 * num_sets, ..., so that each set covers the whole RSM
+    //    A texel drawn with probability p = flux_sum / total carries flux / (samples * p)
+    int num_sets = RSM_INTERLEAVE * RSM_INTERLEAVE;
+    int num_strata = num_sets * samples;
+    indirect_vpls.reserve(num_strata);
+    for (int s = 0; s < num_sets; s++) {
+        for (int j = 0; j < samples; j++) {
+            double u = (j * num_sets + s + 0.5) / num_strata * total;
+            size_t i = std::min(
+                static_cast<size_t>(std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin()), fluxes.size() - 1
+            );
+            float weight = static_cast<float>(total / (samples * fluxes[i].sum()));
+            indirect_vpls.emplace_back(positions[i], normals[i], fluxes[i] * weight);
+        }
+    }
+    printf("Sampled %d indirect VPLs from %ld RSM texels\n", num_strata, static_cast<long>(fluxes.size()));
+}
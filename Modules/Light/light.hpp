@@ -3,6 +3,8 @@
 
 #include "utils.hpp"
 #include "shadowmap.hpp"
+#include "softshadow.hpp"
+#include "lighttree.hpp"
 
 class DirectVPL {
 public:
@@ -13,12 +15,35 @@ public:
     Vec3f intensity;
 };
 
+/**
+ * @brief 光源的影响半径：带衰减时，光强在该距离之外低于 LIGHT_INFLUENCE_CUTOFF。
+ * @param intensity VPL 的光强。
+ */
+inline float influenceRadius(const Vec3f& intensity) {
+    return std::sqrt(std::max(intensity.maxCoeff() / LIGHT_INFLUENCE_CUTOFF - 1.0f, 0.0f));
+}
+
+/**
+ * @brief 距离衰减：平方反比衰减，并乘以在影响半径处平滑降为 0 的窗口函数。
+ * @param distance_sq 着色点到 VPL 距离的平方。
+ * @param radius VPL 的影响半径。
+ */
+inline float distanceFalloff(float distance_sq, float radius) {
+    float ratio_sq = distance_sq / (radius * radius);
+    float window = std::max(1 - ratio_sq * ratio_sq, 0.0f);
+    return window * window / (distance_sq + 1);
+}
+
 class IndirectVPL {
 public:
     IndirectVPL(Vec3f pos, Vec3f flx):
-        position(pos), flux(flx)
+        position(pos), normal(Vec3f::Zero()), flux(flx)
+    {}
+    IndirectVPL(Vec3f pos, Vec3f norm, Vec3f flx):
+        position(pos), normal(norm), flux(flx)
     {}
     Vec3f position;
+    Vec3f normal; // the VPL reflects diffusely into the hemisphere around its normal
     Vec3f flux;
 };
 
@@ -27,29 +52,63 @@ protected:
     Vec3f position_proxy;
     std::vector<DirectVPL> direct_vpls;
     std::vector<IndirectVPL> indirect_vpls;
+    LightTree light_tree;
+    bool soft_shadows = false;
+
+    /**
+     * @brief 由 direct_vpls 构建 VPL 树，在派生类的构造函数生成 VPL 之后调用。
+     */
+    void buildLightTree() {
+        std::vector<Vec3f> positions, intensities;
+        for (const DirectVPL& d_vpl : direct_vpls) {
+            positions.push_back(d_vpl.position);
+            intensities.push_back(d_vpl.intensity);
+        }
+        light_tree.build(positions, intensities);
+    }
+
+    /**
+     * @brief 从反射阴影贴图的纹素中按光通量重要性采样，生成交错采样所用的间接光 VPL 组。
+     * @param positions, normals, fluxes 所有被照亮纹素的世界坐标、单位法线与光通量。
+     * @param samples 每组的 VPL 数，共 RSM_INTERLEAVE * RSM_INTERLEAVE 组。
+     * @note 结果按组连续存放在 indirect_vpls 中，第 s 组为 [s * samples, (s + 1) * samples)。
+     */
+    void sampleIndirectVPLs(
+        const std::vector<Vec3f>& positions, const std::vector<Vec3f>& normals, const std::vector<Vec3f>& fluxes, int samples
+    );
 
 public:
     Light() {}
     Light(std::vector<DirectVPL> d_vpls, std::vector<IndirectVPL> i_vpls):
-        direct_vpls(d_vpls), indirect_vpls(i_vpls)
+        direct_vpls(std::move(d_vpls)), indirect_vpls(std::move(i_vpls))
     {}
     Vec3f getPosition() const {
         return position_proxy;
     }
-    std::vector<DirectVPL> getDirectVPLs() const {
+    const std::vector<DirectVPL>& getDirectVPLs() const {
         return direct_vpls;
     }
-    std::vector<IndirectVPL> getIndirectVPLs() const {
+    const std::vector<IndirectVPL>& getIndirectVPLs() const {
         return indirect_vpls;
     }
+    const LightTree& getLightTree() const {
+        return light_tree;
+    }
+    /**
+     * @brief 是否使用预滤波的软阴影，需在 initShadowMap 之前设置，目前只有区域光源支持。
+     */
+    void setSoftShadows(bool soft) {
+        soft_shadows = soft;
+    }
 
     /**
      * @brief 初始化阴影贴图。
      * @param res 阴影贴图的分辨率。
      * @param objects 场景中的对象列表。
+     * @param indirect_samples 每组间接光 VPL 数，大于 0 时同时生成反射阴影贴图与间接光 VPL。
      * @note 该函数会为光源生成阴影贴图，用于阴影计算。
      */
-    virtual void initShadowMap(int res, std::vector<std::shared_ptr<Object>>& objects) = 0;
+    virtual void initShadowMap(int res, const std::vector<std::shared_ptr<Object>>& objects, int indirect_samples = 0) = 0;
 
     /**
      * @brief 检查指定位置是否被光照到。
@@ -59,6 +118,31 @@ public:
      */
     virtual bool isLighted(Vec3f position) const = 0;
 
+    /**
+     * @brief 批量检查一组位置是否被光照到。
+     * @param positions 连续存放的 count 个世界坐标。
+     * @param lighted 输出，每个位置一个字节，被照到时为 1，否则为 0。
+     */
+    virtual void isLighted(const Vec3f* positions, int count, uint8_t* lighted) const = 0;
+
+    /**
+     * @brief 批量计算一组位置的可见度。
+     * @param positions 连续存放的 count 个世界坐标。
+     * @param visibility 输出，每个位置 [0, 1] 之间的可见度。
+     * @note 默认由 isLighted 得到 0 或 1，软阴影光源返回部分可见度。
+     *       按 SHADOW_LOOKUP_BATCH 个位置分块查询，中间结果放在栈上，不在着色循环中分配内存。
+     */
+    virtual void getVisibility(const Vec3f* positions, int count, float* visibility) const {
+        uint8_t lighted[SHADOW_LOOKUP_BATCH];
+        for (int begin = 0; begin < count; begin += SHADOW_LOOKUP_BATCH) {
+            int batch = std::min(count - begin, SHADOW_LOOKUP_BATCH);
+            isLighted(positions + begin, batch, lighted);
+            for (int k = 0; k < batch; k++) {
+                visibility[begin + k] = lighted[k];
+            }
+        }
+    }
+
     /**
      * @brief 将阴影贴图保存为图像文件。
      * @param file_name 输出图像文件的路径。
@@ -69,23 +153,14 @@ public:
 
 class PointLight: public Light {
 protected:
-    std::vector<std::shared_ptr<ShadowMap>> shadow_maps;
-
-    // Directions Constants
-    Vec3f directions[6] = {
-        Vec3f(1, 0, 0),
-        Vec3f(-1, 0, 0),
-        Vec3f(0, 1, 0),
-        Vec3f(0, -1, 0),
-        Vec3f(0, 0, 1),
-        Vec3f(0, 0, -1)
-    };
+    std::shared_ptr<CubeShadowMap> shadow_map;
 
 public:
     PointLight(Vec3f pos, Vec3f inten) {
         direct_vpls.clear();
         DirectVPL d_vpl(pos, inten);
         direct_vpls.push_back(d_vpl);
+        buildLightTree();
 
         position_proxy = pos;
     }
@@ -94,33 +169,30 @@ public:
      * @brief 初始化点光源的阴影贴图。
      * @param res 阴影贴图的分辨率。
      * @param objects 场景中的对象列表。
-     * @note 点光源需要为每个方向生成 6 张阴影贴图。
+     * @param indirect_samples 每组间接光 VPL 数，为 0 时不生成间接光 VPL。
+     * @note 点光源使用一张立方体阴影贴图，六个面在一次遍历中生成。
      */
-    virtual void initShadowMap(int res, std::vector<std::shared_ptr<Object>>& objects) override {
-        shadow_maps.clear();
-        for (int i = 0; i < 6; i++) {
-            std::shared_ptr<ShadowMap> shadow_map = std::make_shared<ShadowMap>(res);
-            shadow_map->initialize(position_proxy, directions[i]);
-            shadow_map->generateDepthBuffer(objects);
-            shadow_maps.push_back(shadow_map);
-        }
+    virtual void initShadowMap(int res, const std::vector<std::shared_ptr<Object>>& objects, int indirect_samples = 0) override {
+        shadow_map = std::make_shared<CubeShadowMap>(res);
+        shadow_map->initialize(position_proxy);
+        shadow_map->generateDepthBuffer(objects, indirect_samples > 0);
+        std::vector<Vec3f> positions, normals, fluxes;
+        shadow_map->getReflectiveTexels(direct_vpls[0].intensity, positions, normals, fluxes);
+        sampleIndirectVPLs(positions, normals, fluxes, indirect_samples);
     }
     
     /**
      * @brief 检查指定位置是否被点光源照亮。
      * @param position 世界坐标中的位置。
      * @return 如果位置被光照到，返回 true；否则返回 false。
-     * @note 该函数会遍历所有方向的阴影贴图进行判断。
+     * @note 该函数只查询位置所在方向的立方体贴图面。
      */
     virtual bool isLighted(Vec3f position) const override {
-        bool is_shadowed = false;
-        //printf("| ");
-        for (std::shared_ptr<ShadowMap> shadow_map: shadow_maps) {
-            //printf("%d | ", shadow_map->isShadowed(position));
-            is_shadowed = is_shadowed || shadow_map->isLighted(position);
-        }
-        //puts("");
-        return is_shadowed;
+        return shadow_map->isLighted(position);
+    }
+
+    virtual void isLighted(const Vec3f* positions, int count, uint8_t* lighted) const override {
+        shadow_map->isLighted(positions, count, lighted);
     }
 
     /**
@@ -130,21 +202,22 @@ public:
      */
     virtual void showShadowMap(const std::string& file_name) override {
         for (int i = 0; i < 6; i++) {
+            Vec3f direction = CubeShadowMap::getFaceDirection(i);
             std::string sub_file_name = file_name + "_" + std::to_string(i);
             sub_file_name = sub_file_name + "(" + 
-            std::to_string(roundf(directions[i].x() * 100) / 100);
+            std::to_string(roundf(direction.x() * 100) / 100);
             sub_file_name = sub_file_name.substr(0, sub_file_name.size() - 4);
             sub_file_name = sub_file_name + ",";
             
-            sub_file_name = sub_file_name + std::to_string(roundf(directions[i].y() * 100) / 100);
+            sub_file_name = sub_file_name + std::to_string(roundf(direction.y() * 100) / 100);
             sub_file_name = sub_file_name.substr(0, sub_file_name.size() - 4);
             sub_file_name = sub_file_name + ",";
-            sub_file_name = sub_file_name + std::to_string(roundf(directions[i].z() * 100) / 100);
+            sub_file_name = sub_file_name + std::to_string(roundf(direction.z() * 100) / 100);
             sub_file_name = sub_file_name.substr(0, sub_file_name.size() - 4);
             sub_file_name = sub_file_name + ")";
             // Remove last 3 characters
             sub_file_name = sub_file_name + ".png";
-            shadow_maps[i]->showShadowMap(sub_file_name);
+            shadow_map->getFace(i)->showShadowMap(sub_file_name);
         }
     }
 };
@@ -152,6 +225,7 @@ public:
 class AreaLight : public Light {
 protected:
     std::shared_ptr<ShadowMap> shadow_map;
+    std::shared_ptr<SoftShadowMap> soft_shadow_map; // only with soft shadows
     Vec3f normal;
     Vec2f size;
 
@@ -177,7 +251,7 @@ public:
                 direct_vpls.push_back(d_vpl);
             }
         }
-
+        buildLightTree();
 
         position_proxy = pos;
     }
@@ -186,15 +260,35 @@ public:
      * @brief 初始化区域光源的阴影贴图。
      * @param res 阴影贴图的分辨率。
      * @param objects 场景中的对象列表。
-     * @note 区域光源只需要生成一张阴影贴图。
+     * @param indirect_samples 每组间接光 VPL 数，为 0 时不生成间接光 VPL。
+     * @note 区域光源只需要生成一张阴影贴图，反射阴影贴图把整个光源视为位于中心的点光源。
      */
-    virtual void initShadowMap(int res, std::vector<std::shared_ptr<Object>>& objects) override {
+    virtual void initShadowMap(int res, const std::vector<std::shared_ptr<Object>>& objects, int indirect_samples = 0) override {
         std::shared_ptr<ShadowMap> shadow_map = std::make_shared<ShadowMap>(res);
         shadow_map->initialize(position_proxy, normal, 120);
         // printf("Generating Depth Buffer\n");
         // printf("POSITON: %f %f %f\n", position_proxy.x(), position_proxy.y(), position_proxy.z());
         // printf("NORMAL: %f %f %f\n", normal.x(), normal.y(), normal.z());
-        shadow_map->generateDepthBuffer(objects);
+        shadow_map->generateDepthBuffer(objects, indirect_samples > 0);
+        std::vector<Vec3f> positions, normals, fluxes;
+        Vec3f total_intensity = Vec3f::Zero();
+        for (const DirectVPL& d_vpl : direct_vpls) {
+            total_intensity += d_vpl.intensity;
+        }
+        shadow_map->getReflectiveTexels(total_intensity, positions, normals, fluxes);
+        sampleIndirectVPLs(positions, normals, fluxes, indirect_samples);
+
+        // The light size is the extent of its VPLs
+        soft_shadow_map = nullptr;
+        if (soft_shadows) {
+            Vec3f min_bound = Vec3f::Constant(INFINITY), max_bound = Vec3f::Constant(-INFINITY);
+            for (const DirectVPL& d_vpl : direct_vpls) {
+                min_bound = min_bound.cwiseMin(d_vpl.position);
+                max_bound = max_bound.cwiseMax(d_vpl.position);
+            }
+            soft_shadow_map = std::make_shared<SoftShadowMap>();
+            soft_shadow_map->build(*shadow_map, (max_bound - min_bound).maxCoeff());
+        }
 
         this->shadow_map = shadow_map;
     }
@@ -209,6 +303,19 @@ public:
         return shadow_map->isLighted(position);
     }
 
+    virtual void isLighted(const Vec3f* positions, int count, uint8_t* lighted) const override {
+        shadow_map->isLighted(positions, count, lighted);
+    }
+
+    virtual void getVisibility(const Vec3f* positions, int count, float* visibility) const override {
+        if (soft_shadow_map) {
+            soft_shadow_map->visibility(positions, count, visibility);
+        }
+        else {
+            Light::getVisibility(positions, count, visibility);
+        }
+    }
+
     /**
      * @brief 将区域光源的阴影贴图保存为图像文件。
      * @param file_name 输出图像文件的路径。
@@ -0,0 +1,104 @@
+#include "lighttree.hpp"
+#include <algorithm>
+#include <numeric>
+
+void LightTree::build(const std::vector<Vec3f>& positions, const std::vector<Vec3f>& intensities) {
+    nodes.clear();
+    if (positions.empty()) {
+        return;
+    }
+    nodes.reserve(2 * positions.size() - 1);
+    std::vector<uint32_t> ids(positions.size());
+    std::iota(ids.begin(), ids.end(), 0);
+    buildNode(positions, intensities, ids.data(), ids.size());
+}
+
+/**
+ * @brief 递归构建以 ids 中的 VPL 为叶子的子树。
+ * @return 子树根节点的下标。
+ */
+int32_t LightTree::buildNode(const std::vector<Vec3f>& positions, const std::vector<Vec3f>& intensities,
+    uint32_t* ids, int count) {
+    int32_t idx = nodes.size();
+    nodes.push_back(LightNode());
+
+    // 1. Bounds, total intensity and representative of the cluster
+    LightNode node;
+    node.min_bound = node.max_bound = positions[ids[0]];
+    node.intensity = Vec3f::Zero();
+    Vec3f weighted_position = Vec3f::Zero();
+    float weight_sum = 0;
+    for (int i = 0; i < count; i++) {
+        const Vec3f& p = positions[ids[i]];
+        node.min_bound = node.min_bound.cwiseMin(p);
+        node.max_bound = node.max_bound.cwiseMax(p);
+        node.intensity += intensities[ids[i]];
+        float weight = intensities[ids[i]].maxCoeff();
+        weighted_position += weight * p;
+        weight_sum += weight;
+    }
+    node.representative = (weight_sum > 0) ? Vec3f(weighted_position / weight_sum) : positions[ids[0]];
+    if (count == 1) {
+        // Leaves are shaded exactly
+        node.representative = positions[ids[0]];
+    }
+
+    // 2. Split at the median of the longest axis
+    if (count > 1) {
+        int axis;
+        (node.max_bound - node.min_bound).maxCoeff(&axis);
+        int half = count / 2;
+        std::nth_element(ids, ids + half, ids + count, [&](uint32_t a, uint32_t b) {
+            return positions[a][axis] < positions[b][axis];
+        });
+        node.left = buildNode(positions, intensities, ids, half);
+        node.right = buildNode(positions, intensities, ids + half, count - half);
+    }
+    nodes[idx] = node;
+    return idx;
+}
+
+/**
+ * @brief 用簇的代表位置代替其中所有 VPL 带来的误差上界。
+ * @note 簇的包围球对着色点张开半角为 alpha 的方向锥。锥内漫反射项最多变化 alpha，
+ *       高光项（半角向量与法线的夹角是光线方向与反射方向夹角的一半）最多变化 shininess * alpha / 2，
+ *       两者也都不超过各自在锥内的最大值。有衰减时再乘以簇内最大的衰减，并加上衰减本身的变化。
+ */
+float LightTree::errorBound(
+    const LightNode& node, const Vec3f& position, const Vec3f& normal, const Vec3f& reflect_dir,
+    float shininess, bool falloff
+) const {
+    if (node.left < 0) {
+        return 0;
+    }
+    Vec3f center = (node.min_bound + node.max_bound) / 2;
+    float radius = (node.max_bound - node.min_bound).norm() / 2;
+    Vec3f to_center = center - position;
+    float distance = to_center.norm();
+    float variation = 2;
+    if (distance > radius) {
+        // Cone of directions towards the cluster, with half angle alpha
+        float sin_alpha = radius / distance, cos_alpha = std::sqrt(1 - sin_alpha * sin_alpha);
+        float alpha = std::asin(sin_alpha);
+        Vec3f axis = to_center / distance;
+        // Cosine of the smallest angle between a direction in the cone and v: cos(max(theta - alpha, 0))
+        auto maxCosine = [&](const Vec3f& v) {
+            float cos_theta = std::clamp(axis.dot(v), -1.0f, 1.0f);
+            if (cos_theta >= cos_alpha) {
+                return 1.0f;
+            }
+            return cos_theta * cos_alpha + std::sqrt(1 - cos_theta * cos_theta) * sin_alpha;
+        };
+        float max_diffuse = std::max(maxCosine(normal), 0.0f);
+        // cos^s of half the angle to the reflected direction
+        float max_specular = std::pow((1 + maxCosine(reflect_dir)) / 2, shininess / 2);
+        variation = std::min(alpha, max_diffuse) + std::min(shininess * alpha / 2, max_specular);
+    }
+    if (falloff) {
+        float near = std::max(distance - radius, 0.0f), far = distance + radius;
+        float max_falloff = 1 / (near * near + 1), min_falloff = 1 / (far * far + 1);
+        // The diffuse and specular terms are at most 1 each
+        variation = variation * max_falloff + 2 * (max_falloff - min_falloff);
+    }
+    return node.intensity.maxCoeff() * variation;
+}
@@ -0,0 +1,112 @@
+#ifndef LIGHTTREE_HPP_
+#define LIGHTTREE_HPP_
+
+#include "utils.hpp"
+#include <cstdint>
+
+/*
+Light Tree (Lightcuts)
+    A binary tree over the VPLs of a light. Each node is a cluster of VPLs with its bounding
+    box, its total intensity and a representative position, the intensity weighted centroid.
+    A cluster is shaded as if all of its intensity came from the representative.
+
+    For each shading point a cut through the tree is chosen: starting from the root, the
+    cluster with the largest error bound is replaced by its children until every bound is
+    below tolerance * (estimated radiance), or the cut reaches LIGHTCUT_MAX_SIZE clusters.
+    Leaves are single VPLs and have no error. The error bound of a cluster follows from the
+    cone of directions it subtends at the shading point: across the cone the diffuse and
+    specular terms change by at most the cone angle (times shininess / 2 for the specular
+    lobe), and by no more than their maxima over the cone.
+
+    Reference: Walter et al., "Lightcuts: A Scalable Approach to Illumination", 2005.
+*/
+
+struct LightNode {
+    Vec3f min_bound = Vec3f::Zero(), max_bound = Vec3f::Zero();
+    Vec3f intensity = Vec3f::Zero();      // sum over the VPLs in the cluster
+    Vec3f representative = Vec3f::Zero(); // intensity weighted centroid of the VPLs
+    int32_t left = -1, right = -1;        // child nodes, -1 for leaves
+};
+
+class LightTree {
+public:
+    /**
+     * @brief 自顶向下构建 VPL 二叉树，每次沿包围盒最长轴在中位数处划分。
+     * @param positions, intensities 光源的 VPL 位置与光强。
+     */
+    void build(const std::vector<Vec3f>& positions, const std::vector<Vec3f>& intensities);
+
+    /**
+     * @brief 为一个着色点选择光割并累加各簇的贡献。
+     * @param position, normal 着色点的世界坐标与单位法线。
+     * @param reflect_dir 视线方向关于法线的反射方向，用于估计高光项的上界。
+     * @param shininess 着色点材质的高光指数，用于估计高光项的误差。
+     * @param tolerance 相对误差容限，误差上界低于 tolerance 倍的估计值时停止细分。
+     * @param falloff 是否有距离衰减。
+     * @param shade 形如 Vec3f(const Vec3f& position, const Vec3f& intensity) 的函数，
+     *              返回位于 position、光强为 intensity 的 VPL 的着色结果。
+     * @return 所有簇贡献之和。
+     */
+    template <typename ShadeFunc>
+    Vec3f evaluateCut(
+        const Vec3f& position, const Vec3f& normal, const Vec3f& reflect_dir, float shininess,
+        float tolerance, bool falloff, ShadeFunc&& shade
+    ) const;
+
+    bool empty() const { return nodes.empty(); }
+    const std::vector<LightNode>& getNodes() const { return nodes; }
+
+private:
+    int32_t buildNode(const std::vector<Vec3f>& positions, const std::vector<Vec3f>& intensities,
+        uint32_t* ids, int count);
+    float errorBound(
+        const LightNode& node, const Vec3f& position, const Vec3f& normal, const Vec3f& reflect_dir,
+        float shininess, bool falloff
+    ) const;
+
+    std::vector<LightNode> nodes; // nodes[0] is the root
+};
+
+template <typename ShadeFunc>
+Vec3f LightTree::evaluateCut(
+    const Vec3f& position, const Vec3f& normal, const Vec3f& reflect_dir, float shininess,
+    float tolerance, bool falloff, ShadeFunc&& shade
+) const {
+    // The cut is kept in a small fixed array, the cluster with the largest bound is found by a linear scan
+    struct CutEntry {
+        int32_t node;
+        float bound;
+        Vec3f estimate;
+    };
+    CutEntry cut[LIGHTCUT_MAX_SIZE];
+    int cut_size = 1;
+    cut[0] = {0, errorBound(nodes[0], position, normal, reflect_dir, shininess, falloff), shade(nodes[0].representative, nodes[0].intensity)};
+    Vec3f total = cut[0].estimate;
+
+    while (cut_size < LIGHTCUT_MAX_SIZE) {
+        int worst = 0;
+        for (int i = 1; i < cut_size; i++) {
+            if (cut[i].bound > cut[worst].bound) {
+                worst = i;
+            }
+        }
+        // Leaves have no error and cannot be refined; the estimate is kept by repeated sums and may round
+        // to a negative value or become NaN, so the tolerance test alone could select a leaf
+        if (cut[worst].bound <= 0 || nodes[cut[worst].node].left < 0 || cut[worst].bound <= tolerance * total.maxCoeff()) {
+            break;
+        }
+        // Refine: replace the cluster by its children
+        const LightNode& node = nodes[cut[worst].node];
+        total -= cut[worst].estimate;
+        int32_t children[2] = {node.left, node.right};
+        int slots[2] = {worst, cut_size++};
+        for (int c = 0; c < 2; c++) {
+            const LightNode& child = nodes[children[c]];
+            cut[slots[c]] = {children[c], errorBound(child, position, normal, reflect_dir, shininess, falloff), shade(child.representative, child.intensity)};
+            total += cut[slots[c]].estimate;
+        }
+    }
+    return total;
+}
+
+#endif // LIGHTTREE_HPP_
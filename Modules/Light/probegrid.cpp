@@ -0,0 +1,210 @@
+#include "probegrid.hpp"
+#include <fstream>
+#include <filesystem>
+#include <omp.h>
+
+static const uint32_t PROBE_FILE_MAGIC = 0x42525048; // "HPRB"
+static const uint32_t PROBE_FILE_VERSION = 2;
+
+/**
+ * @brief 计算二阶实球谐基函数在单位方向 d 上的值。
+ */
+static void evalSHBasis(const Vec3f& d, float basis[PROBE_SH_COEFFS]) {
+    float x = d.x(), y = d.y(), z = d.z();
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * y;
+    basis[2] = 0.488603f * z;
+    basis[3] = 0.488603f * x;
+    basis[4] = 1.092548f * x * y;
+    basis[5] = 1.092548f * y * z;
+    basis[6] = 0.315392f * (3 * z * z - 1);
+    basis[7] = 1.092548f * x * z;
+    basis[8] = 0.546274f * (x * x - y * y);
+}
+
+/**
+ * @brief FNV-1a 哈希，逐字节累加到 hash 上。
+ */
+static void hashBytes(uint64_t& hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+}
+
+uint64_t IrradianceProbeGrid::computeKey(const std::string& scene) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    int resolution = PROBE_GRID_RESOLUTION;
+    hashBytes(hash, &resolution, sizeof(resolution));
+    hashBytes(hash, scene.data(), scene.size());
+    return hash;
+}
+
+void IrradianceProbeGrid::build(
+    const Vec3f& min_bound, const Vec3f& max_bound,
+    const std::vector<Vec3f>& positions, const std::vector<Vec3f>& normals, const std::vector<Vec3f>& fluxes,
+    uint64_t key
+) {
+    // 1. Cubic cells, PROBE_GRID_RESOLUTION along the longest axis
+    Vec3f extent = (max_bound - min_bound).cwiseMax(LENGTH_EPS);
+    float cell = extent.maxCoeff() / PROBE_GRID_RESOLUTION;
+    for (int a = 0; a < 3; a++) {
+        dims[a] = std::max(static_cast<int>(std::ceil(extent[a] / cell - 1e-3f)), 1);
+    }
+    this->min_bound = min_bound;
+    cell_size = extent.cwiseQuotient(dims.cast<float>());
+    this->key = key;
+    int num_probes = dims.prod();
+    coefficients.assign(num_probes * PROBE_SH_COEFFS, Vec3f::Zero());
+
+    // 2. Project the radiance of the VPLs onto each probe
+    //    A diffuse VPL seen from distance r at cosine cos_vpl contributes flux * cos_vpl / (pi * r^2) from its direction
+    //    The clamped cosine convolution (pi, 2pi/3, pi/4 per band) turns radiance into irradiance coefficients
+    const float band_scale[PROBE_SH_COEFFS] = {
+        static_cast<float>(M_PI),
+        static_cast<float>(2 * M_PI / 3), static_cast<float>(2 * M_PI / 3), static_cast<float>(2 * M_PI / 3),
+        static_cast<float>(M_PI / 4), static_cast<float>(M_PI / 4), static_cast<float>(M_PI / 4),
+        static_cast<float>(M_PI / 4), static_cast<float>(M_PI / 4)
+    };
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int p = 0; p < num_probes; p++) {
+        Vec3i cell_id(p % dims.x(), (p / dims.x()) % dims.y(), p / (dims.x() * dims.y()));
+        Vec3f probe_position = min_bound + (cell_id.cast<float>() + Vec3f::Constant(0.5f)).cwiseProduct(cell_size);
+        Vec3f* probe = &coefficients[p * PROBE_SH_COEFFS];
+        float basis[PROBE_SH_COEFFS];
+        for (size_t k = 0; k < positions.size(); k++) {
+            Vec3f to_vpl = positions[k] - probe_position;
+            float distance_sq = to_vpl.squaredNorm();
+            if (distance_sq == 0) {
+                continue;
+            }
+            float distance = std::sqrt(distance_sq);
+            float cos_vpl = -to_vpl.dot(normals[k]) / distance;
+            if (cos_vpl <= 0) {
+                continue;
+            }
+            evalSHBasis(to_vpl / distance, basis);
+            Vec3f radiance = fluxes[k] * (cos_vpl /
+                (std::max(distance_sq, RSM_MIN_DISTANCE * RSM_MIN_DISTANCE) * static_cast<float>(M_PI)));
+            for (int c = 0; c < PROBE_SH_COEFFS; c++) {
+                probe[c] += radiance * basis[c];
+            }
+        }
+        for (int c = 0; c < PROBE_SH_COEFFS; c++) {
+            probe[c] *= band_scale[c];
+        }
+    }
+    printf("Built %dx%dx%d irradiance probes from %ld indirect VPLs\n",
+        dims.x(), dims.y(), dims.z(), static_cast<long>(positions.size()));
+}
+
+Vec3f IrradianceProbeGrid::evalIrradiance(const Vec3f& position, const Vec3f& normal) const {
+    // Continuous grid coordinates with probes at integers, clamped to the outermost probes
+    Vec3f grid = (position - min_bound).cwiseQuotient(cell_size) - Vec3f::Constant(0.5f);
+    Vec3i base;
+    Vec3f frac;
+    for (int a = 0; a < 3; a++) {
+        float g = std::min(std::max(grid[a], 0.0f), static_cast<float>(dims[a] - 1));
+        base[a] = std::min(static_cast<int>(g), std::max(dims[a] - 2, 0));
+        frac[a] = g - base[a];
+    }
+
+    // Trilinear blend of the coefficients, then evaluate the irradiance in the normal direction
+    Vec3f sh[PROBE_SH_COEFFS];
+    for (int c = 0; c < PROBE_SH_COEFFS; c++) {
+        sh[c] = Vec3f::Zero();
+    }
+    for (int corner = 0; corner < 8; corner++) {
+        Vec3i offset(corner & 1, (corner >> 1) & 1, corner >> 2);
+        float weight = 1;
+        for (int a = 0; a < 3; a++) {
+            weight *= offset[a] ? frac[a] : 1 - frac[a];
+        }
+        if (weight == 0) {
+            continue;
+        }
+        Vec3i id = (base + offset).cwiseMin(dims - Vec3i::Ones());
+        const Vec3f* probe = &coefficients[((id.z() * dims.y() + id.y()) * dims.x() + id.x()) * PROBE_SH_COEFFS];
+        for (int c = 0; c < PROBE_SH_COEFFS; c++) {
+            sh[c] += weight * probe[c];
+        }
+    }
+    float basis[PROBE_SH_COEFFS];
+    evalSHBasis(normal, basis);
+    Vec3f irradiance = Vec3f::Zero();
+    for (int c = 0; c < PROBE_SH_COEFFS; c++) {
+        irradiance += sh[c] * basis[c];
+    }
+    // Truncated harmonics can ring below zero
+    return irradiance.cwiseMax(0.0f);
+}
+
+bool IrradianceProbeGrid::save(const std::string& file_name) const {
+    // Write to a temporary file first, so that an interrupted save never leaves a torn grid behind
+    std::string temp_file = utils::temporaryFileName(file_name);
+    {
+        std::ofstream file(temp_file, std::ios::binary);
+        if (!file) {
+            printf("Failed to write the probe grid: %s\n", file_name.c_str());
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&PROBE_FILE_MAGIC), sizeof(PROBE_FILE_MAGIC));
+        file.write(reinterpret_cast<const char*>(&PROBE_FILE_VERSION), sizeof(PROBE_FILE_VERSION));
+        file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+        file.write(reinterpret_cast<const char*>(dims.data()), sizeof(int) * 3);
+        file.write(reinterpret_cast<const char*>(min_bound.data()), sizeof(float) * 3);
+        file.write(reinterpret_cast<const char*>(cell_size.data()), sizeof(float) * 3);
+        file.write(reinterpret_cast<const char*>(coefficients.data()), sizeof(Vec3f) * coefficients.size());
+        file.close();
+        if (!file) {
+            std::error_code error;
+            std::filesystem::remove(temp_file, error);
+            printf("Failed to write the probe grid: %s\n", file_name.c_str());
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_file, file_name, error);
+    if (error) {
+        std::filesystem::remove(temp_file, error);
+        printf("Failed to write the probe grid: %s\n", file_name.c_str());
+        return false;
+    }
+    printf("Saved the probe grid to %s\n", file_name.c_str());
+    return true;
+}
+
+bool IrradianceProbeGrid::load(const std::string& file_name, uint64_t key) {
+    std::ifstream file(file_name, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    uint32_t magic = 0, version = 0;
+    uint64_t file_key = 0;
+    Vec3i file_dims;
+    Vec3f file_min_bound, file_cell_size;
+    file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&file_key), sizeof(file_key));
+    file.read(reinterpret_cast<char*>(file_dims.data()), sizeof(int) * 3);
+    file.read(reinterpret_cast<char*>(file_min_bound.data()), sizeof(float) * 3);
+    file.read(reinterpret_cast<char*>(file_cell_size.data()), sizeof(float) * 3);
+    if (!file || magic != PROBE_FILE_MAGIC || version != PROBE_FILE_VERSION || file_key != key
+        || file_dims.minCoeff() < 1 || file_dims.maxCoeff() > PROBE_GRID_RESOLUTION) {
+        printf("Probe grid %s is stale or invalid, rebuilding\n", file_name.c_str());
+        return false;
+    }
+    std::vector<Vec3f> file_coefficients(file_dims.prod() * PROBE_SH_COEFFS);
+    file.read(reinterpret_cast<char*>(file_coefficients.data()), sizeof(Vec3f) * file_coefficients.size());
+    if (!file) {
+        printf("Probe grid %s is truncated, rebuilding\n", file_name.c_str());
+        return false;
+    }
+    dims = file_dims;
+    min_bound = file_min_bound;
+    cell_size = file_cell_size;
+    this->key = key;
+    coefficients.swap(file_coefficients);
+    printf("Loaded the probe grid from %s\n", file_name.c_str());
+    return true;
+}
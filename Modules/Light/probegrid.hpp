@@ -0,0 +1,74 @@
+#ifndef PROBEGRID_HPP_
+#define PROBEGRID_HPP_
+
+#include "utils.hpp"
+#include <cstdint>
+
+/*
+Irradiance Probe Grid
+    A regular 3D grid of probes over the scene bounds, one probe at the center of each cell.
+    Each probe stores the incoming indirect radiance as order 2 spherical harmonics (9 RGB
+    coefficients), projected from the indirect VPLs of the reflective shadow maps. The VPLs
+    only exist where the lights reach, so the shadow visibility of the first bounce is included.
+
+    A shading point blends the 8 surrounding probes trilinearly and convolves the result with
+    the clamped cosine lobe around its normal, which gives the indirect irradiance at O(1) cost.
+    The grid depends only on the scene and the lights, not on the camera, and can be saved to
+    disk and reused by later renders of the same static scene. The file is keyed by a hash of
+    the scene description, so a matching file is found before any reflective shadow map is drawn.
+
+    Reference: Ramamoorthi and Hanrahan, "An Efficient Representation for Irradiance Environment Maps", 2001.
+*/
+
+class IrradianceProbeGrid {
+public:
+    /**
+     * @brief 计算场景描述与探针分辨率的哈希值，用于判断磁盘上的探针网格是否仍然有效。
+     * @param scene 决定间接光的场景内容（网格、变换、材质与光源等）按固定顺序拼接成的字节串。
+     * @note 键只取决于场景本身，因此可以在生成反射阴影贴图之前检查缓存。
+     */
+    static uint64_t computeKey(const std::string& scene);
+
+    /**
+     * @brief 在场景包围盒内构建探针网格，最长轴上有 PROBE_GRID_RESOLUTION 个探针。
+     * @param min_bound, max_bound 场景的包围盒。
+     * @param positions, normals, fluxes 间接光 VPL 的世界坐标、单位法线与光通量。
+     * @param key 场景的键，随网格一起保存。
+     */
+    void build(
+        const Vec3f& min_bound, const Vec3f& max_bound,
+        const std::vector<Vec3f>& positions, const std::vector<Vec3f>& normals, const std::vector<Vec3f>& fluxes,
+        uint64_t key = 0
+    );
+
+    /**
+     * @brief 查询间接光辐照度。
+     * @param position 着色点的世界坐标，包围盒外的点使用最近的探针。
+     * @param normal 着色点的单位法线。
+     */
+    Vec3f evalIrradiance(const Vec3f& position, const Vec3f& normal) const;
+
+    /**
+     * @brief 将探针网格保存为二进制文件。
+     * @note 先写入临时文件再重命名，中断的保存不会留下不完整的文件。
+     * @return 写入成功时返回 true。
+     */
+    bool save(const std::string& file_name) const;
+
+    /**
+     * @brief 从二进制文件读取探针网格。
+     * @param key 期望的哈希值，与文件中的不一致时视为失效。
+     * @return 文件存在、格式正确且哈希值一致时返回 true，否则网格保持不变。
+     */
+    bool load(const std::string& file_name, uint64_t key);
+
+    bool empty() const { return coefficients.empty(); }
+
+private:
+    Vec3i dims = Vec3i::Zero();
+    Vec3f min_bound = Vec3f::Zero(), cell_size = Vec3f::Ones();
+    uint64_t key = 0;
+    std::vector<Vec3f> coefficients; // PROBE_SH_COEFFS per probe, probes in x-major order
+};
+
+#endif // PROBEGRID_HPP_
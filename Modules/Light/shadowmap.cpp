@@ -1,99 +1,172 @@
 #include "shadowmap.hpp"
 #include "image.hpp"
+#include "rastercore.hpp"
 
 /**
  * @brief 生成深度缓冲区，用于阴影计算。
  * @param objects 场景中的对象列表。
+ * @param reflective 是否同时生成反射阴影贴图（每个纹素的世界坐标、法线与反照率），用于间接光照。
  * @note 该函数会将对象的三角形投影到屏幕空间，并更新深度缓冲区。
  *       仅支持三角形面片，且深度值范围为 [-1, 0]。
  */
-void ShadowMap::generateDepthBuffer(std::vector<std::shared_ptr<Object>>& objects) {
-    for (std::shared_ptr<Object> obj: objects) {
-        Mat4f view_mat = camera->getViewMatrix(), proj_mat = camera->getProjectionMatrix(true);
-        auto triangles = obj->getTriangles();
-        for (Triangle tri: triangles) {
-            // For each Triangle, project the vertices, and update the depth buffer
-            // 1. Vertex Processing
-            Triangle screen_space_tri;
-            for (int i = 0; i < 3; i++) {
-                Vertex vert = tri.getVertex(i);
-                Vec4f org_pos = Vec4f(vert.position.x(), vert.position.y(), vert.position.z(), 1);
-                
-                // Apply the Transformation
-                Vertex new_vert = vert;
-                Vec4f pos = proj_mat * view_mat * org_pos;
-                
-                new_vert.position = Vec3f(pos.x() / pos.w(), pos.y() / pos.w(), pos.z() / pos.w());
-                
-                screen_space_tri.setVertex(i, new_vert);
-            }
-            
-            // Transform the Triangle to Screen Space
-            Vec2f min_screen = screen_space_tri.getXYMin(), max_screen = screen_space_tri.getXYMax();
-            
-            // If invalid, continue
-            if (
-                ((min_screen.x() > 1) && (max_screen.x() > 1))
-                ||
-                ((min_screen.x() < -1) && (max_screen.x() < -1))
-                ||
-                ((min_screen.y() > 1) && (max_screen.y() > 1))
-                ||
-                ((min_screen.y() < -1) && (max_screen.y() < -1))
-                ||
-                ((min_screen.x() > max_screen.x()) || (min_screen.y() > max_screen.y()))
-            ){
+void ShadowMap::generateDepthBuffer(const std::vector<std::shared_ptr<Object>>& objects, bool reflective) {
+    Mat4f view_projection = getViewProjectionMatrix();
+    TriangleClipper clipper(resolution.x(), resolution.y());
+    int object_culled_cnt = 0;
+    Mat4Xf clip_positions;
+    clearReflectiveBuffers(reflective);
+    for (const std::shared_ptr<Object>& obj: objects) {
+        // Skip the objects whose bounding boxes are outside the light's view frustum
+        if (isBoxOutsideFrustum(view_projection, obj->getMinBound(), obj->getMaxBound())) {
+            object_culled_cnt++;
+            continue;
+        }
+        // 1. Vertex Processing: transform all vertices into clip space with the fused model-view-projection matrix
+        clip_positions.noalias() = (view_projection * obj->getModelMatrix()) * obj->getPositions();
+        const std::vector<uint32_t>& indices = obj->getIndices();
+        const Materials* material = obj->getMaterial().get();
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            Vec4f clip[3] = {clip_positions.col(indices[t]), clip_positions.col(indices[t + 1]), clip_positions.col(indices[t + 2])};
+            drawTriangle(clip, clipper, *obj, &indices[t], material, reflective);
+        }
+    }
+    printf("Shadow Map: %d of %ld objects culled\n", object_culled_cnt, static_cast<long>(objects.size()));
+}
+
+/**
+ * @brief 清空反射阴影贴图。
+ * @param reflective 为 true 时分配并清零反射阴影贴图，否则释放。
+ */
+void ShadowMap::clearReflectiveBuffers(bool reflective) {
+    int texel_cnt = reflective ? resolution.x() * resolution.y() : 0;
+    rsm_positions.assign(texel_cnt, Vec3f::Zero());
+    rsm_normals.assign(texel_cnt, Vec3f::Zero());
+    rsm_albedos.assign(texel_cnt, Vec3f::Zero());
+}
+
+/**
+ * @brief 反射阴影贴图的片元属性，插值三个角点的世界坐标、法线与纹理坐标。
+ */
+struct ReflectiveAttributes {
+    std::vector<Vec3f>* positions, * normals, * albedos;
+    int stride;
+    const Materials* material;
+    Mat3f world_positions, world_normals;
+    Eigen::Matrix<float, 2, 3> uvs;
+
+    void operator()(int x, int y, const Vec3f& weights, float) const {
+        int idx = y * stride + x;
+        (*positions)[idx] = world_positions * weights;
+        (*normals)[idx] = (world_normals * weights).normalized();
+        (*albedos)[idx] = material ? material->evalColor(uvs * weights) : Vec3f::Zero();
+    }
+};
+
+/**
+ * @brief 裁剪并光栅化一个三角形，更新深度缓冲区。
+ * @param clip 三个顶点在光源裁剪空间中的坐标。
+ * @param clipper 按阴影贴图分辨率构造的裁剪器。
+ * @param obj, indices 三角形所属的对象及其三个顶点索引，用于插值反射阴影贴图的属性。
+ * @param material 对象的材质，可以为空。
+ * @param reflective 是否同时写入反射阴影贴图，否则使用只写深度的光栅化。
+ */
+void ShadowMap::drawTriangle(
+    const Vec4f clip[3], const TriangleClipper& clipper, const Object& obj, const uint32_t* indices,
+    const Materials* material, bool reflective
+) {
+    if (!reflective) {
+        clipTriangle(clipper, clip, [&](const ClipVertex* const*, const Vec3f ndc[3]) {
+            rasterizeBiased(ndc, DepthOnlyAttributes());
+        });
+        return;
+    }
+
+    // World attributes of the triangle's vertices, only needed by the reflective shadow map
+    Mat3f world_positions, world_normals;
+    Eigen::Matrix<float, 2, 3> uvs;
+    for (int i = 0; i < 3; i++) {
+        uint32_t idx = indices[i];
+        world_positions.col(i) = (obj.getModelMatrix() * obj.getPositions().col(idx)).head<3>();
+        world_normals.col(i) = obj.getNormalMatrix() * obj.getNormals().col(idx);
+        uvs.col(i) = obj.getUVs().col(idx);
+    }
+    ReflectiveAttributes attributes{
+        &rsm_positions, &rsm_normals, &rsm_albedos, resolution.x(), material, world_positions, world_normals, uvs
+    };
+    clipTriangle(clipper, clip, [&](const ClipVertex* const corners[3], const Vec3f ndc[3]) {
+        // The corners of a clipped triangle are weighted sums of the input vertices
+        Mat3f fan_weights;
+        fan_weights << corners[0]->weights, corners[1]->weights, corners[2]->weights;
+        attributes.world_positions.noalias() = world_positions * fan_weights;
+        attributes.world_normals.noalias() = world_normals * fan_weights;
+        attributes.uvs.noalias() = uvs * fan_weights;
+        rasterizeBiased(ndc, attributes);
+    });
+}
+
+/**
+ * @brief 以给定的片元属性光栅化一个已裁剪的三角形，并施加斜率缩放的深度偏移。
+ * @param ndc 三个顶点透视除法后的坐标。
+ * @param attributes 片元属性，见 rastercore.hpp。
+ */
+template <typename Attributes>
+void ShadowMap::rasterizeBiased(const Vec3f ndc[3], const Attributes& attributes) {
+    // 1. Triangle Setup
+    TriangleSetup setup;
+    if (!setup.setup(ndc[0], ndc[1], ndc[2], resolution.x(), resolution.y())) {
+        return;
+    }
+    // Slope-scaled depth bias: push the triangle back by its depth change over
+    // SHADOW_MAP_SLOPE_BIAS pixels, so that surfaces seen at grazing angles do not shadow themselves.
+    // z is twice the stored depth.
+    float dz_dx = (setup.A[0] * setup.z[0] + setup.A[1] * setup.z[1] + setup.A[2] * setup.z[2]) * setup.inv_area,
+        dz_dy = (setup.B[0] * setup.z[0] + setup.B[1] * setup.z[1] + setup.B[2] * setup.z[2]) * setup.inv_area;
+    // The bias is clamped, otherwise occluders parallel to the light rays would leak light
+    float z_bias = std::min(
+        SHADOW_MAP_SLOPE_BIAS * std::max(std::abs(dz_dx), std::abs(dz_dy)), 2 * SHADOW_MAP_MAX_SLOPE_BIAS
+    );
+    for (int i = 0; i < 3; i++) {
+        setup.z[i] -= z_bias;
+    }
+
+    // 2. Rasterize the Triangle
+    // Only the front-most pixel with depth in [-1, 0] is considered, i.e. stored depth >= 0.5
+    rasterizeTriangle(
+        setup, setup.min_x, setup.min_y, setup.max_x, setup.max_y,
+        depth_buffer.data(), resolution.x(), 0.5f, attributes
+    );
+}
+
+/**
+ * @brief 将反射阴影贴图的纹素转换为间接光 VPL 的数据。
+ * @param intensity 光源的总光强。
+ * @param positions, normals, fluxes 追加每个被照亮纹素的世界坐标、单位法线与反射的光通量。
+ * @note 需先以 reflective = true 调用 generateDepthBuffer。
+ *       与直接光照一致，表面的辐照度为 I * cos(theta)，不随距离衰减。纹素在距离 r 处覆盖的面积为
+ *       omega * r^2 / cos(theta)，omega 为纹素的立体角，因此反射的光通量为 I * omega * r^2 * albedo。
+ */
+void ShadowMap::getReflectiveTexels(
+    const Vec3f& intensity, std::vector<Vec3f>& positions, std::vector<Vec3f>& normals, std::vector<Vec3f>& fluxes
+) const {
+    if (rsm_positions.empty()) {
+        return;
+    }
+    Vec3f light_position = camera->getPosition();
+    // Half extent of the image plane at unit distance, and the texel size on it
+    float tan_half_fov = std::tan(camera->getFOV() / 2 * M_PI / 180);
+    float texel_size = 2 * tan_half_fov / resolution.x();
+    for (int y = 0; y < resolution.y(); y++) {
+        for (int x = 0; x < resolution.x(); x++) {
+            int idx = y * resolution.x() + x;
+            if (depth_buffer[idx] >= 1 || rsm_albedos[idx].isZero()) {
                 continue;
             }
-            
-            float width = static_cast<float>(resolution.x()), height = static_cast<float>(resolution.y());
-            Vec2i min_screen_i = Vec2i(
-                static_cast<int>((min_screen.x() + 1) / 2 * width),
-                static_cast<int>((min_screen.y() + 1) / 2 * height)
-            ),
-            max_screen_i = Vec2i(
-                static_cast<int>((max_screen.x() + 1) / 2 * width),
-                static_cast<int>((max_screen.y() + 1) / 2 * height)
-            );
-            // Clip the bounding box
-            min_screen_i = (min_screen_i - Vec2i(1, 1)).cwiseMax(Vec2i(0, 0));
-            max_screen_i = (max_screen_i + Vec2i(1, 1)).cwiseMin(resolution);
-
-            // Count the pixels
-            int num_pixels = (max_screen_i.x() - min_screen_i.x()) * (max_screen_i.y() - min_screen_i.y());
-
-            if (num_pixels < 0) continue;
-            // Rasterize the Triangle
-            for (int x = min_screen_i.x(); x < max_screen_i.x(); x++) {
-                for (int y = min_screen_i.y(); y < max_screen_i.y(); y++) {
-                    Vec3f pos = Vec3f(
-                        2 * static_cast<float>(x) / width - 1,
-                        2 * static_cast<float>(y) / height - 1,
-                        0
-                    );
-                    if (screen_space_tri.isInsidefor2D(pos)) {
-                        Vec3f weights = screen_space_tri.getInterpolationWeightsfor2D(pos);
-                        // Check weights valid
-                        if (!utils::isValidWeight(weights)) {
-                            continue;
-                        }
-                        // Depth
-                        float depth = weights.x() * screen_space_tri.getVertex(0).position.z() +
-                            weights.y() * screen_space_tri.getVertex(1).position.z() +
-                            weights.z() * screen_space_tri.getVertex(2).position.z();
-                        // Check the Depth Buffer
-                        // Only the front-most pixel is considered
-                        if (depth < -1 || depth > 0) {
-                            continue;
-                        }
-                        if (std::abs((depth-1)/2) >= depth_buffer[y * resolution.x() + x]) {
-                            continue;
-                        }
-                        // Write to the Depth Buffer
-                        depth_buffer[y * resolution.x() + x] = std::abs((depth-1)/2);
-                    }
-                }
-            }
+            float u = (2.0f * x / resolution.x() - 1) * tan_half_fov, v = (2.0f * y / resolution.y() - 1) * tan_half_fov;
+            float solid_angle = texel_size * texel_size / std::pow(1 + u * u + v * v, 1.5f);
+            float distance_sq = (rsm_positions[idx] - light_position).squaredNorm();
+            positions.push_back(rsm_positions[idx]);
+            normals.push_back(rsm_normals[idx]);
+            fluxes.push_back(intensity.cwiseProduct(rsm_albedos[idx]) * (solid_angle * distance_sq));
         }
     }
 }
@@ -105,26 +178,27 @@ void ShadowMap::generateDepthBuffer(std::vector<std::shared_ptr<Object>>& object
  * @note 该函数会将位置投影到屏幕空间，并与深度缓冲区进行比较。
  */
 bool ShadowMap::isLighted(Vec3f position) const {
-    Mat4f view_mat = camera->getViewMatrix(), proj_mat = camera->getProjectionMatrix(true);
-    Vec4f pos = Vec4f(position.x(), position.y(), position.z(), 1);
-    Vec4f proj_pos = proj_mat * view_mat * pos;
-    Vec3f screen_pos = Vec3f(proj_pos.x() / proj_pos.w(), proj_pos.y() / proj_pos.w(), proj_pos.z() / proj_pos.w());
-    int x = static_cast<int>((screen_pos.x() + 1) / 2 * resolution.x()),
-        y = static_cast<int>((screen_pos.y() + 1) / 2 * resolution.y());
-    if (x < 0 || x >= resolution.x() || y < 0 || y >= resolution.y()) {
-        return false;
-    }
-    if (x >= 0 && x < resolution.x() && y >= 0 && y < resolution.y()) {
-        float depth = screen_pos.z();
-        if (std::abs((depth-1)/2) <= depth_buffer[y * resolution.x() + x] + SHADOW_MAP_BIAS) {
-            //printf("depth:%f\n",depth);
-            return true;
-        }
-        else {
-            return false;
+    return isLightedClip(light_view_projection * Vec4f(position.x(), position.y(), position.z(), 1));
+}
+
+/**
+ * @brief 批量检查一组位置是否被光照到。
+ * @param positions 连续存放的 count 个世界坐标。
+ * @param lighted 输出，每个位置一个字节，被照到时为 1，否则为 0。
+ * @note 每 SHADOW_LOOKUP_BATCH 个位置用一次矩阵乘法变换到光源裁剪空间，再逐个与深度缓冲区比较，
+ *       变换结果放在栈上。
+ */
+void ShadowMap::isLighted(const Vec3f* positions, int count, uint8_t* lighted) const {
+    Eigen::Matrix<float, 4, SHADOW_LOOKUP_BATCH> clip;
+    for (int begin = 0; begin < count; begin += SHADOW_LOOKUP_BATCH) {
+        int batch = std::min(count - begin, SHADOW_LOOKUP_BATCH);
+        Eigen::Map<const Mat3Xf> world(positions[begin].data(), 3, batch);
+        clip.leftCols(batch).noalias() = light_view_projection.leftCols<3>() * world;
+        clip.leftCols(batch).colwise() += light_view_projection.col(3);
+        for (int k = 0; k < batch; k++) {
+            lighted[begin + k] = isLightedClip(clip.col(k));
         }
     }
-    return false;
 }
 
 /**
@@ -145,4 +219,161 @@ void ShadowMap::showShadowMap(const std::string& file_name) {
         depth_buffer_tofile[i] = (depth_buffer[i] - min_value) / (max_value - min_value);
     }
     writeImageToFile(depth_buffer_tofile, resolution, file_name);
-}
\ No newline at end of file
+}
+
+CubeShadowMap::CubeShadowMap(int res) {
+    for (int f = 0; f < 6; f++) {
+        faces.push_back(std::make_shared<ShadowMap>(res));
+        // The face of a query is chosen by the dominant axis, so the query never lies outside of it
+        faces[f]->setClampToEdge(true);
+    }
+}
+
+/**
+ * @brief 初始化六个面的相机。
+ * @param position 点光源的位置。
+ */
+void CubeShadowMap::initialize(Vec3f position) {
+    this->position = position;
+    for (int f = 0; f < 6; f++) {
+        faces[f]->initialize(position, getFaceDirection(f));
+    }
+}
+
+/**
+ * @brief 单次遍历场景生成六个面的深度缓冲区。
+ * @param objects 场景中的对象列表。
+ * @param reflective 是否同时生成反射阴影贴图。
+ * @note 包围盒在六个面的视锥之外的对象被整体跳过。
+ *       每个三角形只分配给与其相交的面：面 (a, s) 的视锥为 s * d_a >= |d_b| 且 s * d_a >= |d_c|，
+ *       d 为光源到顶点的向量，三个顶点都在同一侧平面之外的三角形不会进入该面。
+ */
+void CubeShadowMap::generateDepthBuffer(const std::vector<std::shared_ptr<Object>>& objects, bool reflective) {
+    // 1. Transform every vertex into world space once, and bin the triangles to the faces
+    //    A bin entry is (object, first index of the triangle)
+    //    Only the world positions are kept, w = 1 is restored when the triangles are projected
+    Mat4f view_projections[6];
+    for (int f = 0; f < 6; f++) {
+        view_projections[f] = faces[f]->getViewProjectionMatrix();
+    }
+    std::vector<Mat3Xf> world_positions(objects.size());
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> bins(6);
+    size_t triangle_cnt = 0;
+    int object_culled_cnt = 0;
+    for (size_t o = 0; o < objects.size(); o++) {
+        const Object& obj = *objects[o];
+        // Skip the objects whose bounding boxes are outside the view frusta of all six faces,
+        // the triangles of the others are only binned to the faces whose frusta their boxes touch
+        uint32_t face_mask = 0;
+        for (int f = 0; f < 6; f++) {
+            face_mask |= !isBoxOutsideFrustum(view_projections[f], obj.getMinBound(), obj.getMaxBound()) << f;
+        }
+        if (face_mask == 0) {
+            object_culled_cnt++;
+            continue;
+        }
+        world_positions[o].noalias() = obj.getModelMatrix().topRows<3>() * obj.getPositions();
+        const std::vector<uint32_t>& indices = obj.getIndices();
+        triangle_cnt += indices.size() / 3;
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            // Bit 4 * f + p: the vertex is outside the p-th side plane of face f
+            uint32_t outcode_and = (1u << 24) - 1;
+            for (int i = 0; i < 3; i++) {
+                Vec3f d = world_positions[o].col(indices[t + i]) - position;
+                uint32_t outcode = 0;
+                for (int f = 0; f < 6; f++) {
+                    int a = f / 2;
+                    float major = (f % 2) ? -d[a] : d[a], minor_b = d[(a + 1) % 3], minor_c = d[(a + 2) % 3];
+                    outcode |= ((major < minor_b) | (major < -minor_b) << 1 | (major < minor_c) << 2 | (major < -minor_c) << 3) << (4 * f);
+                }
+                outcode_and &= outcode;
+            }
+            for (int f = 0; f < 6; f++) {
+                if ((face_mask >> f & 1) && ((outcode_and >> (4 * f)) & 0xF) == 0) {
+                    bins[f].emplace_back(o, t);
+                }
+            }
+        }
+    }
+
+    // 2. Rasterize the faces in parallel, each face only writes its own buffers
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int f = 0; f < 6; f++) {
+        ShadowMap& face = *faces[f];
+        const Mat4f& view_projection = view_projections[f];
+        TriangleClipper clipper(face.getResolution().x(), face.getResolution().y());
+        face.clearReflectiveBuffers(reflective);
+        for (const std::pair<uint32_t, uint32_t>& entry : bins[f]) {
+            const Object& obj = *objects[entry.first];
+            const uint32_t* tri = &obj.getIndices()[entry.second];
+            Vec4f clip[3];
+            for (int i = 0; i < 3; i++) {
+                clip[i] = view_projection * world_positions[entry.first].col(tri[i]).homogeneous();
+            }
+            face.drawTriangle(clip, clipper, obj, tri, obj.getMaterial().get(), reflective);
+        }
+    }
+    size_t binned_cnt = 0;
+    for (const auto& bin : bins) {
+        binned_cnt += bin.size();
+    }
+    printf("Cube Shadow Map: %d of %ld objects culled, %ld triangles binned to %ld faces\n",
+        object_culled_cnt, static_cast<long>(objects.size()),
+        static_cast<long>(triangle_cnt), static_cast<long>(binned_cnt));
+}
+
+void CubeShadowMap::getReflectiveTexels(
+    const Vec3f& intensity, std::vector<Vec3f>& positions, std::vector<Vec3f>& normals, std::vector<Vec3f>& fluxes
+) const {
+    for (const std::shared_ptr<ShadowMap>& face : faces) {
+        face->getReflectiveTexels(intensity, positions, normals, fluxes);
+    }
+}
+
+/**
+ * @brief 检查指定位置是否被点光源照到。
+ * @param position 世界坐标中的位置。
+ * @note 只查询光源到该位置的向量的主轴方向对应的面。
+ */
+bool CubeShadowMap::isLighted(Vec3f position) const {
+    return faces[faceOf(position)]->isLighted(position);
+}
+
+/**
+ * @brief 批量检查一组位置是否被点光源照到。
+ * @param positions 连续存放的 count 个世界坐标。
+ * @param lighted 输出，每个位置一个字节，被照到时为 1，否则为 0。
+ * @note 位置先按所在的面分组，每个面批量查询一次。
+ */
+void CubeShadowMap::isLighted(const Vec3f* positions, int count, uint8_t* lighted) const {
+    // The positions are processed in chunks, so that the scratch of the sort lives on the stack
+    uint8_t face_of[SHADOW_LOOKUP_BATCH], sorted_lighted[SHADOW_LOOKUP_BATCH];
+    uint32_t order[SHADOW_LOOKUP_BATCH];
+    Vec3f sorted[SHADOW_LOOKUP_BATCH];
+    for (int begin = 0; begin < count; begin += SHADOW_LOOKUP_BATCH) {
+        int batch = std::min(count - begin, SHADOW_LOOKUP_BATCH);
+        // Counting sort of the positions by face
+        int face_begin[7] = {0};
+        for (int k = 0; k < batch; k++) {
+            face_of[k] = faceOf(positions[begin + k]);
+            face_begin[face_of[k] + 1]++;
+        }
+        for (int f = 0; f < 6; f++) {
+            face_begin[f + 1] += face_begin[f];
+        }
+        int fill[6];
+        std::copy(face_begin, face_begin + 6, fill);
+        for (int k = 0; k < batch; k++) {
+            int slot = fill[face_of[k]]++;
+            order[slot] = k;
+            sorted[slot] = positions[begin + k];
+        }
+
+        for (int f = 0; f < 6; f++) {
+            faces[f]->isLighted(sorted + face_begin[f], face_begin[f + 1] - face_begin[f], sorted_lighted + face_begin[f]);
+        }
+        for (int k = 0; k < batch; k++) {
+            lighted[begin + order[k]] = sorted_lighted[k];
+        }
+    }
+}
@@ -5,6 +5,8 @@
 #include "camera.hpp"
 #include "object.hpp"
 
+class TriangleClipper;
+
 class ShadowMap {
 public:
     // Constructors
@@ -22,19 +24,112 @@ public:
         camera->setFOV(fov);
         camera->setFocalLength(0.1);
         camera->setResolution(resolution);
+        light_view_projection = camera->getProjectionMatrix(true) * camera->getViewMatrix();
     }
 
-    void generateDepthBuffer(std::vector<std::shared_ptr<Object>>& objects);
+    // Faces of a cube shadow map: a point on the boundary of its face is looked up in the edge texel
+    void setClampToEdge(bool clamp) { clamp_to_edge = clamp; }
+
+    Vec2i getResolution() const { return resolution; }
+    const std::shared_ptr<Camera>& getCamera() const { return camera; }
+    const std::vector<float>& getDepthBuffer() const { return depth_buffer; }
+    const Mat4f& getViewProjectionMatrix() const { return light_view_projection; }
+
+    void generateDepthBuffer(const std::vector<std::shared_ptr<Object>>& objects, bool reflective = false);
+
+    void clearReflectiveBuffers(bool reflective);
+
+    void drawTriangle(
+        const Vec4f clip[3], const TriangleClipper& clipper, const Object& obj, const uint32_t* indices,
+        const Materials* material, bool reflective
+    );
+
+    void getReflectiveTexels(
+        const Vec3f& intensity, std::vector<Vec3f>& positions, std::vector<Vec3f>& normals, std::vector<Vec3f>& fluxes
+    ) const;
 
     bool isLighted(Vec3f position) const;
 
+    void isLighted(const Vec3f* positions, int count, uint8_t* lighted) const;
+
     void showShadowMap(const std::string& file_name);
 private:
+    template <typename Attributes>
+    void rasterizeBiased(const Vec3f ndc[3], const Attributes& attributes);
+
+    /**
+     * @brief 对光源裁剪空间中的一点做深度测试。
+     * @note 阴影贴图之外的点视为在阴影中；立方体阴影贴图的面按主轴选取，NDC 恰为 ±1 的边界点钳制到边缘纹素。
+     */
+    bool isLightedClip(const Vec4f& clip) const {
+        float inv_w = 1 / clip.w();
+        int x = static_cast<int>((clip.x() * inv_w + 1) / 2 * resolution.x()),
+            y = static_cast<int>((clip.y() * inv_w + 1) / 2 * resolution.y());
+        if (clamp_to_edge) {
+            x = std::clamp(x, 0, resolution.x() - 1);
+            y = std::clamp(y, 0, resolution.y() - 1);
+        }
+        else if (x < 0 || x >= resolution.x() || y < 0 || y >= resolution.y()) {
+            return false;
+        }
+        return std::abs((clip.z() * inv_w - 1) / 2) <= depth_buffer[y * resolution.x() + x] + SHADOW_MAP_BIAS;
+    }
+
     Vec2i resolution;
+    bool clamp_to_edge = false;
 
     std::shared_ptr<Camera> camera;
+    Mat4f light_view_projection; // cached at initialize, the camera does not move afterwards
     std::vector<float> depth_buffer;
     std::vector<float> depth_buffer_tofile;
+    /* Reflective Shadow Map: world position, unit normal and albedo of the front-most surface per texel */
+    std::vector<Vec3f> rsm_positions, rsm_normals, rsm_albedos;
+};
+
+/*
+Cube Shadow Map
+    The omnidirectional shadow map of a point light, six 90 degree faces along +X, -X, +Y, -Y, +Z, -Z.
+    The triangles are transformed once and binned to the faces whose frusta they overlap,
+    then the faces are rasterized in parallel, each from its own bin.
+    A query only reads the face of the dominant axis of the light-to-point vector.
+*/
+
+class CubeShadowMap {
+public:
+    CubeShadowMap(int res);
+
+    void initialize(Vec3f position);
+
+    void generateDepthBuffer(const std::vector<std::shared_ptr<Object>>& objects, bool reflective = false);
+
+    void getReflectiveTexels(
+        const Vec3f& intensity, std::vector<Vec3f>& positions, std::vector<Vec3f>& normals, std::vector<Vec3f>& fluxes
+    ) const;
+
+    bool isLighted(Vec3f position) const;
+
+    void isLighted(const Vec3f* positions, int count, uint8_t* lighted) const;
+
+    static Vec3f getFaceDirection(int face) {
+        Vec3f direction = Vec3f::Zero();
+        direction[face / 2] = (face % 2) ? -1 : 1;
+        return direction;
+    }
+    const std::shared_ptr<ShadowMap>& getFace(int face) const { return faces[face]; }
+
+private:
+    /**
+     * @brief 光源到该位置的向量的主轴方向对应的面。
+     */
+    int faceOf(const Vec3f& position) const {
+        Vec3f d = position - this->position;
+        int axis;
+        d.cwiseAbs().maxCoeff(&axis);
+        return 2 * axis + (d[axis] < 0);
+    }
+
+    Vec3f position;
+    std::vector<std::shared_ptr<ShadowMap>> faces; // face 2 * axis + (direction < 0)
 };
 
 #endif // SHADOWMAP_HPP_
\ No newline at end of file
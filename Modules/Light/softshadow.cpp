@@ -0,0 +1,189 @@
+#include "softshadow.hpp"
+#include <algorithm>
+
+/**
+ * @brief 对数空间中的加权平均：log(sum_i weights[i] * exp(values[i]))。
+ * @note 先减去最大值再求指数，避免 exp(c * d) 溢出。
+ */
+static float logSumExp(const float* values, const float* weights, int count) {
+    float max_value = values[0];
+    for (int i = 1; i < count; i++) {
+        max_value = std::max(max_value, values[i]);
+    }
+    float sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += weights[i] * std::exp(values[i] - max_value);
+    }
+    return max_value + std::log(sum);
+}
+
+/**
+ * @brief 沿一个方向的盒式滤波，边界处重复边缘纹素。
+ * @param vertical 为 false 时沿水平方向滤波，否则沿竖直方向。
+ * @note 纹素存放的是 c * d，滤波在对数空间中进行。
+ */
+static void boxBlurPass(const std::vector<float>& src, std::vector<float>& dst, int width, int height, bool vertical) {
+    const int taps = 2 * SOFT_SHADOW_BLUR_RADIUS + 1;
+    float weights[taps];
+    std::fill(weights, weights + taps, 1.0f / taps);
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; y++) {
+        float values[taps];
+        for (int x = 0; x < width; x++) {
+            for (int k = -SOFT_SHADOW_BLUR_RADIUS; k <= SOFT_SHADOW_BLUR_RADIUS; k++) {
+                int sx = vertical ? x : std::min(std::max(x + k, 0), width - 1),
+                    sy = vertical ? std::min(std::max(y + k, 0), height - 1) : y;
+                values[k + SOFT_SHADOW_BLUR_RADIUS] = src[sy * width + sx];
+            }
+            dst[y * width + x] = logSumExp(values, weights, taps);
+        }
+    }
+}
+
+void SoftShadowMap::build(const ShadowMap& shadow_map, float light_size) {
+    const Camera& camera = *shadow_map.getCamera();
+    Vec2i resolution = shadow_map.getResolution();
+    const std::vector<float>& depth_buffer = shadow_map.getDepthBuffer();
+    light_view_projection = shadow_map.getViewProjectionMatrix();
+    this->light_size = light_size;
+    texel_angle = 2 * std::tan(camera.getFOV() / 2 * M_PI / 180) / resolution.x();
+
+    // 1. Level 0: linear view distance of the stored depth
+    //    The stored depth d maps to z_ndc = 1 - 2d, and z_ndc to the distance 2nf / ((n + f) + (f - n) z_ndc)
+    int texel_cnt = resolution.x() * resolution.y();
+    float near = camera.getFocalLength(), far = DEFAULT_FAR;
+    std::vector<float> linear_depth(texel_cnt), exponential(texel_cnt), blurred(texel_cnt);
+    for (int i = 0; i < texel_cnt; i++) {
+        float z_ndc = 1 - 2 * depth_buffer[i];
+        linear_depth[i] = std::min(2 * near * far / ((near + far) + (far - near) * z_ndc), far);
+        exponential[i] = SOFT_SHADOW_ESM_EXPONENT * linear_depth[i];
+    }
+
+    // 2. Prefilter the exponential map with a separable box filter
+    boxBlurPass(exponential, blurred, resolution.x(), resolution.y(), false);
+    boxBlurPass(blurred, exponential, resolution.x(), resolution.y(), true);
+
+    // 3. Mip chains: 2x2 average of the exponential map, 2x2 minimum of the depths
+    mip_sizes.assign(1, resolution);
+    exponential_mips.assign(1, std::move(exponential));
+    min_depth_mips.assign(1, std::move(linear_depth));
+    while (static_cast<int>(mip_sizes.size()) < SOFT_SHADOW_MIP_LEVELS && mip_sizes.back().minCoeff() > 1) {
+        Vec2i src_size = mip_sizes.back(), dst_size = (src_size / 2).cwiseMax(1);
+        const std::vector<float>& src_exp = exponential_mips.back(), & src_min = min_depth_mips.back();
+        std::vector<float> dst_exp(dst_size.prod()), dst_min(dst_size.prod());
+        for (int y = 0; y < dst_size.y(); y++) {
+            for (int x = 0; x < dst_size.x(); x++) {
+                int x0 = std::min(2 * x, src_size.x() - 1), x1 = std::min(2 * x + 1, src_size.x() - 1),
+                    y0 = std::min(2 * y, src_size.y() - 1), y1 = std::min(2 * y + 1, src_size.y() - 1);
+                int i00 = y0 * src_size.x() + x0, i01 = y0 * src_size.x() + x1,
+                    i10 = y1 * src_size.x() + x0, i11 = y1 * src_size.x() + x1;
+                const float values[4] = {src_exp[i00], src_exp[i01], src_exp[i10], src_exp[i11]}, weights[4] = {0.25f, 0.25f, 0.25f, 0.25f};
+                dst_exp[y * dst_size.x() + x] = logSumExp(values, weights, 4);
+                dst_min[y * dst_size.x() + x] = std::min(std::min(src_min[i00], src_min[i01]), std::min(src_min[i10], src_min[i11]));
+            }
+        }
+        mip_sizes.push_back(dst_size);
+        exponential_mips.push_back(std::move(dst_exp));
+        min_depth_mips.push_back(std::move(dst_min));
+    }
+}
+
+/**
+ * @brief 双线性采样指数阴影贴图，返回 log(E[exp(c * d)])。
+ * @param level mip 层级。
+ * @param u, v 以第 0 层纹素为单位的坐标，纹素 x 位于 u = x 处。
+ */
+float SoftShadowMap::sampleExponential(int level, float u, float v) const {
+    const Vec2i& size = mip_sizes[level];
+    const std::vector<float>& texels = exponential_mips[level];
+    // A texel of level L covers 2^L texels of level 0, its sample position is at their center
+    float scale = 1.0f / (1 << level), offset = 0.5f * ((1 << level) - 1);
+    float fu = std::min(std::max((u - offset) * scale, 0.0f), static_cast<float>(size.x() - 1)),
+        fv = std::min(std::max((v - offset) * scale, 0.0f), static_cast<float>(size.y() - 1));
+    int x0 = static_cast<int>(fu), y0 = static_cast<int>(fv);
+    int x1 = std::min(x0 + 1, size.x() - 1), y1 = std::min(y0 + 1, size.y() - 1);
+    float tx = fu - x0, ty = fv - y0;
+    const float values[4] = {
+        texels[y0 * size.x() + x0], texels[y0 * size.x() + x1], texels[y1 * size.x() + x0], texels[y1 * size.x() + x1]
+    };
+    const float weights[4] = {(1 - tx) * (1 - ty), tx * (1 - ty), (1 - tx) * ty, tx * ty};
+    return logSumExp(values, weights, 4);
+}
+
+/**
+ * @brief 读取最小深度，取双线性采样的 2x2 纹素中的最小值。
+ * @param level mip 层级。
+ * @param u, v 以第 0 层纹素为单位的坐标。
+ */
+float SoftShadowMap::sampleMinDepth(int level, float u, float v) const {
+    const Vec2i& size = mip_sizes[level];
+    const std::vector<float>& texels = min_depth_mips[level];
+    float scale = 1.0f / (1 << level), offset = 0.5f * ((1 << level) - 1);
+    float fu = std::min(std::max((u - offset) * scale, 0.0f), static_cast<float>(size.x() - 1)),
+        fv = std::min(std::max((v - offset) * scale, 0.0f), static_cast<float>(size.y() - 1));
+    int x0 = static_cast<int>(fu), y0 = static_cast<int>(fv);
+    int x1 = std::min(x0 + 1, size.x() - 1), y1 = std::min(y0 + 1, size.y() - 1);
+    return std::min(
+        std::min(texels[y0 * size.x() + x0], texels[y0 * size.x() + x1]),
+        std::min(texels[y1 * size.x() + x0], texels[y1 * size.x() + x1])
+    );
+}
+
+/**
+ * @brief 计算光源裁剪空间中一点的可见度。
+ */
+float SoftShadowMap::visibilityClip(const Vec4f& clip) const {
+    // The clip w is the view distance from the light
+    if (clip.w() <= 0) {
+        return 0;
+    }
+    const Vec2i& resolution = mip_sizes[0];
+    float u = (clip.x() / clip.w() + 1) / 2 * resolution.x(), v = (clip.y() / clip.w() + 1) / 2 * resolution.y();
+    if (u < 0 || u >= resolution.x() || v < 0 || v >= resolution.y()) {
+        return 0;
+    }
+    float receiver_depth = clip.w() - SOFT_SHADOW_BIAS;
+    int max_level = mip_sizes.size() - 1;
+
+    // 1. Blocker search: the nearest depth over the footprint of the light seen from the receiver
+    float footprint = light_size / clip.w() / texel_angle;
+    int search_level = std::min(static_cast<int>(std::ceil(std::log2(std::max(footprint, 1.0f)))), max_level);
+    float blocker_depth = sampleMinDepth(search_level, u, v);
+    if (blocker_depth >= receiver_depth) {
+        return 1;
+    }
+
+    // 2. Penumbra width in level 0 texels at the receiver, the box filter already spans 2 * radius + 1 texels
+    float penumbra = light_size * (receiver_depth - blocker_depth) / blocker_depth / clip.w() / texel_angle;
+    float level = std::min(
+        std::log2(std::max(penumbra / (2 * SOFT_SHADOW_BLUR_RADIUS + 1), 1.0f)), static_cast<float>(max_level)
+    );
+
+    // 3. Trilinear lookup of the exponential map
+    int level0 = static_cast<int>(level), level1 = std::min(level0 + 1, max_level);
+    float t = level - level0;
+    float log_occluder = sampleExponential(level0, u, v);
+    if (t > 0) {
+        const float values[2] = {log_occluder, sampleExponential(level1, u, v)}, weights[2] = {1 - t, t};
+        log_occluder = logSumExp(values, weights, 2);
+    }
+    return std::min(std::exp(log_occluder - SOFT_SHADOW_ESM_EXPONENT * receiver_depth), 1.0f);
+}
+
+float SoftShadowMap::visibility(const Vec3f& position) const {
+    return visibilityClip(light_view_projection * Vec4f(position.x(), position.y(), position.z(), 1));
+}
+
+void SoftShadowMap::visibility(const Vec3f* positions, int count, float* visibility) const {
+    // Chunks of SHADOW_LOOKUP_BATCH positions, the clip space positions are kept on the stack
+    Eigen::Matrix<float, 4, SHADOW_LOOKUP_BATCH> clip;
+    for (int begin = 0; begin < count; begin += SHADOW_LOOKUP_BATCH) {
+        int batch = std::min(count - begin, SHADOW_LOOKUP_BATCH);
+        Eigen::Map<const Mat3Xf> world(positions[begin].data(), 3, batch);
+        clip.leftCols(batch).noalias() = light_view_projection.leftCols<3>() * world;
+        clip.leftCols(batch).colwise() += light_view_projection.col(3);
+        for (int k = 0; k < batch; k++) {
+            visibility[begin + k] = visibilityClip(clip.col(k));
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef SOFTSHADOW_HPP_
+#define SOFTSHADOW_HPP_
+
+#include "shadowmap.hpp"
+
+/*
+Soft Shadow Map
+    Prefiltered soft shadows for area lights, built from the depth buffer of a ShadowMap.
+
+    Exponential shadow map: each texel represents exp(c * t), t the occluder's view distance from the light.
+    For a receiver at t_r behind all the occluders of a filter footprint, exp(-c * t_r) * E[exp(c * t)]
+    is the filtered visibility, so the texels are blurred by a separable box filter and reduced into a
+    mip chain once, and a lookup costs two bilinear taps at any filter width. The texels store c * t and
+    are filtered in log space, so that a sharp exponent does not overflow.
+
+    The filter width follows the penumbra of the area light, as in percentage-closer soft shadows:
+    the nearest blocker is read from a min-depth mip chain at the level covering the light's footprint,
+    then the penumbra width light_size * (t_r - t_b) / t_b selects the mip level of the exponential map.
+    Receivers without blockers in the footprint are fully lit.
+
+    Reference: Annen et al., "Exponential Shadow Maps", 2008; Fernando, "Percentage-Closer Soft Shadows", 2005.
+*/
+
+class SoftShadowMap {
+public:
+    /**
+     * @brief 由硬阴影贴图的深度缓冲区构建指数阴影贴图与最小深度的 mip 链。
+     * @param shadow_map 已生成深度缓冲区的阴影贴图。
+     * @param light_size 面光源的尺寸（世界坐标）。
+     */
+    void build(const ShadowMap& shadow_map, float light_size);
+
+    /**
+     * @brief 计算指定位置的可见度。
+     * @param position 世界坐标中的位置。
+     * @return [0, 1] 之间的可见度，阴影贴图范围之外为 0。
+     */
+    float visibility(const Vec3f& position) const;
+
+    /**
+     * @brief 批量计算一组位置的可见度。
+     * @param positions 连续存放的 count 个世界坐标。
+     * @param visibility 输出，每个位置的可见度。
+     */
+    void visibility(const Vec3f* positions, int count, float* visibility) const;
+
+private:
+    float visibilityClip(const Vec4f& clip) const;
+    float sampleExponential(int level, float u, float v) const;
+    float sampleMinDepth(int level, float u, float v) const;
+
+    Mat4f light_view_projection;
+    float light_size = 0;
+    float texel_angle = 0; // size of a level 0 texel on the image plane at unit distance
+    std::vector<Vec2i> mip_sizes;
+    std::vector<std::vector<float>> exponential_mips; // log of the blurred exp(c * t)
+    std::vector<std::vector<float>> min_depth_mips;   // nearest t per texel
+};
+
+#endif // SOFTSHADOW_HPP_
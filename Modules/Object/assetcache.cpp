@@ -0,0 +1,68 @@
+#include "assetcache.hpp"
+#include <filesystem>
+
+/**
+ * @brief 按内容哈希查找资源，未命中时在锁外调用 load(file_name, key) 加载。
+ * @param hash 计算路径内容键的函数，每个路径只调用一次。
+ * @note 路径不存在时不缓存，直接交给 load 报告错误。
+ */
+template <typename Asset, typename HashFunc, typename LoadFunc>
+std::shared_ptr<const Asset> AssetCache::getAsset(
+    std::unordered_map<uint64_t, std::shared_ptr<const Asset>>& assets, const std::string& file_name,
+    HashFunc&& hash, LoadFunc&& load
+) {
+    std::error_code error;
+    if (!std::filesystem::exists(file_name, error)) {
+        return load(file_name, 0);
+    }
+
+    // 1. Content key of the path, computed once per path
+    uint64_t key = getKey(file_name, hash);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = assets.find(key);
+        if (found != assets.end()) {
+            return found->second;
+        }
+    }
+
+    // 2. Load outside of the lock, the first stored copy wins
+    std::shared_ptr<const Asset> asset = load(file_name, key);
+    std::lock_guard<std::mutex> lock(mutex);
+    return assets.emplace(key, asset).first->second;
+}
+
+/**
+ * @brief 路径对应的内容键，首次请求时在锁外调用 hash 计算并记住。
+ */
+template <typename HashFunc>
+uint64_t AssetCache::getKey(const std::string& file_name, HashFunc&& hash) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = path_keys.find(file_name);
+        if (found != path_keys.end()) {
+            return found->second;
+        }
+    }
+    uint64_t key = hash(file_name);
+    std::lock_guard<std::mutex> lock(mutex);
+    return path_keys.emplace(file_name, key).first->second;
+}
+
+uint64_t AssetCache::getMeshKey(const std::string& file_name) {
+    return getKey(file_name, hashMeshSource);
+}
+
+uint64_t AssetCache::getTextureKey(const std::string& file_name) {
+    return getKey(file_name, hashFileContents);
+}
+
+std::shared_ptr<const MeshData> AssetCache::getMesh(const std::string& file_name) {
+    return getAsset(meshes, file_name, hashMeshSource,
+        [](const std::string& file, uint64_t key) { return Object::loadMesh(file, key); });
+}
+
+std::shared_ptr<const TextureData> AssetCache::getTexture(const std::string& file_name) {
+    return getAsset(textures, file_name, hashFileContents,
+        [](const std::string& file, uint64_t) { return TextureData::load(file); });
+}
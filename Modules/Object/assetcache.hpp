@@ -0,0 +1,68 @@
+#ifndef ASSETCACHE_HPP_
+#define ASSETCACHE_HPP_
+
+#include "object.hpp"
+#include <mutex>
+#include <unordered_map>
+
+/*
+Asset Cache
+    Content-addressed store of the immutable assets shared between objects and materials:
+    meshes (MeshData) and decoded textures (TextureData). An asset is keyed by the hash of
+    its file contents, so a file referenced several times, through different paths or as
+    a copy, is loaded once. The key of each path is computed once and memoized; the key of a
+    mesh is read from the header of its mesh cache while that is current (see hashMeshSource),
+    so a warm run does not read the mesh sources at all.
+
+    Objects created from a shared mesh are instances: they own their matrices, bounds and
+    material, see Object::localToWorld for the only case in which an instance copies data.
+
+    The cache is thread-safe. Different assets load in parallel outside of the lock; when two
+    threads load the same contents at once, the first stored copy is kept and returned to both.
+*/
+
+class AssetCache {
+public:
+    /**
+     * @brief 取得网格，首次请求时加载。
+     * @param file_name 网格文件路径。
+     */
+    std::shared_ptr<const MeshData> getMesh(const std::string& file_name);
+
+    /**
+     * @brief 取得解码后的纹理，首次请求时解码。
+     * @param file_name 图像文件路径。
+     */
+    std::shared_ptr<const TextureData> getTexture(const std::string& file_name);
+
+    /**
+     * @brief 网格文件内容的哈希值，即网格在缓存中的键，每个路径只计算一次。
+     * @param file_name 网格文件路径。
+     */
+    uint64_t getMeshKey(const std::string& file_name);
+
+    /**
+     * @brief 图像文件内容的哈希值，即纹理在缓存中的键，每个路径只计算一次。
+     * @param file_name 图像文件路径。
+     */
+    uint64_t getTextureKey(const std::string& file_name);
+
+    size_t getMeshCount() const { return meshes.size(); }
+    size_t getTextureCount() const { return textures.size(); }
+
+private:
+    template <typename Asset, typename HashFunc, typename LoadFunc>
+    std::shared_ptr<const Asset> getAsset(
+        std::unordered_map<uint64_t, std::shared_ptr<const Asset>>& assets, const std::string& file_name,
+        HashFunc&& hash, LoadFunc&& load
+    );
+    template <typename HashFunc>
+    uint64_t getKey(const std::string& file_name, HashFunc&& hash);
+
+    std::mutex mutex;
+    std::unordered_map<std::string, uint64_t> path_keys; // file path -> content hash
+    std::unordered_map<uint64_t, std::shared_ptr<const MeshData>> meshes;
+    std::unordered_map<uint64_t, std::shared_ptr<const TextureData>> textures;
+};
+
+#endif // ASSETCACHE_HPP_
@@ -28,7 +28,7 @@ public:
     Triangle(Vertex v0, Vertex v1, Vertex v2, std::shared_ptr<Materials> mat) : v0(v0), v1(v1), v2(v2), material(mat) {}
 
     /* Getters and Setters */
-    Vertex getVertex(int idx) const {
+    const Vertex& getVertex(int idx) const {
         if (idx == 0) {
             return v0;
         } else if (idx == 1) {
@@ -67,9 +67,9 @@ public:
 
     /* Material */
     void setMaterial(std::shared_ptr<Materials> mat) {
-        material = mat;
+        material = std::move(mat);
     }
-    std::shared_ptr<Materials> getMaterial() const {
+    const std::shared_ptr<Materials>& getMaterial() const {
         return material;
     }
 };
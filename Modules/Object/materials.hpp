@@ -2,6 +2,7 @@
 #define MATERIALS_HPP_
 
 #include "utils.hpp"
+#include <algorithm>
 
 class Materials {
 protected:
@@ -25,41 +26,58 @@ public:
     }
 };
 
+/**
+ * @brief 解码后的纹理，不可变，可由多个材质共享。
+ */
+struct TextureData {
+    int width = 1024, height = 1024;
+    std::vector<Vec3f> texels; // premultiplied by alpha
+
+    /**
+     * @brief 从图像文件解码纹理。
+     */
+    static std::shared_ptr<const TextureData> load(const std::string& file_name) {
+        std::shared_ptr<TextureData> data = std::make_shared<TextureData>();
+        // Load Texture from image file
+        std::vector<Vec4f> raw = readImageFromFile(file_name);
+        int width = data->width, height = data->height;
+        // Resize the texture to width * height
+        data->texels.resize(width * height);
+        for (int i = 0; i < width; i++) {
+            for (int j = 0; j < height; j++) {
+                float alpha = raw[j * width + i].w();
+                data->texels[j * width + i] = raw[j * width + i].head(3) * alpha;
+            }
+        }
+        return data;
+    }
+};
+
 class TextureMaterial : public Materials {
-    std::vector<Vec3f> texture;
-    int width, height;
+    std::shared_ptr<const TextureData> texture;
 public:
-    TextureMaterial(): Materials(shininess), width(1024), height(1024) {}
+    TextureMaterial(): Materials(shininess), texture(std::make_shared<TextureData>()) {}
     TextureMaterial(const std::string& file_name): 
-        Materials(shininess), width(1024), height(1024) {  
+        Materials(shininess) {  
         loadTexture(file_name);
     }
     TextureMaterial(const std::string& file_name, float shininess) : 
-        Materials(shininess), width(1024), height(1024) {
+        Materials(shininess) {
         loadTexture(file_name);
     }
+    TextureMaterial(std::shared_ptr<const TextureData> texture, float shininess) :
+        Materials(shininess), texture(texture) {}
 
     virtual Vec3f evalColor(Vec2f uv) const override {
         // Get the color from the texture
+        int width = texture->width, height = texture->height;
         int x = uv.x() * width, y = uv.y() * height;
-        return texture[y * width + x];
+        x = std::clamp(x, 0, width - 1), y = std::clamp(y, 0, height - 1);
+        return texture->texels[y * width + x];
     }
 
     void loadTexture(const std::string& file_name) {
-        // Load Texture from image file
-        std::vector<Vec4f> raw = readImageFromFile(file_name);
-        // Resize the texture to width * height
-        texture.resize(width * height);
-        for (int i = 0; i < width; i++) {
-            for (int j = 0; j < height; j++) {
-                float alpha = raw[j * width + i].w();
-                texture[j * width + i] = raw[j * width + i].head(3) * alpha;
-                // If not zero
-                // if (raw[j*width+i].x() != 0 || raw[j*width+i].y() != 0 || raw[j*width+i].z() != 0){
-                //     utils::printVec(raw[j*width+i]);
-                // }
-            }
-        }
+        texture = TextureData::load(file_name);
     }
 };
 
@@ -0,0 +1,266 @@
+#include "meshcache.hpp"
+#include <cstring>
+#include <fstream>
+#include <filesystem>
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const uint32_t MESH_FILE_MAGIC = 0x48534d48; // "HMSH"
+static const uint32_t MESH_FILE_VERSION = 2;
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t path_hash;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint64_t source_hash;
+    uint32_t vertex_cnt;
+    uint32_t index_cnt;
+    float min_bound[3];
+    float max_bound[3];
+};
+
+/**
+ * @brief 只读映射整个文件，不支持 mmap 的平台退回到一次性读入内存。
+ */
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& file_name) {
+#ifdef _WIN32
+        std::ifstream file(file_name, std::ios::binary);
+        if (file) {
+            buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            bytes = reinterpret_cast<const uint8_t*>(buffer.data());
+            length = buffer.size();
+        }
+#else
+        int fd = open(file_name.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                bytes = static_cast<const uint8_t*>(mapped);
+                length = info.st_size;
+            }
+        }
+        // The mapping stays valid after the descriptor is closed
+        close(fd);
+#endif
+    }
+    ~MappedFile() {
+#ifndef _WIN32
+        if (bytes) {
+            munmap(const_cast<uint8_t*>(bytes), length);
+        }
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const uint8_t* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    std::vector<char> buffer;
+#endif
+};
+
+/**
+ * @brief FNV-1a 哈希，逐字节累加到 hash 上。
+ */
+static void hashBytes(uint64_t& hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+}
+
+/**
+ * @brief 源文件的路径哈希、大小与修改时间，用于快速判断缓存是否有效。
+ * @return 源文件不存在时返回 false。
+ */
+static bool sourceStamp(const std::string& source_file, uint64_t& path_hash, uint64_t& size, int64_t& mtime) {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    // Symbolic links are resolved, so that the same file reached by different paths shares the cache
+    fs::path path = fs::weakly_canonical(source_file, error);
+    size = fs::file_size(source_file, error);
+    if (error) {
+        return false;
+    }
+    mtime = fs::last_write_time(source_file, error).time_since_epoch().count();
+    if (error) {
+        return false;
+    }
+    std::string path_string = path.string();
+    path_hash = 0xcbf29ce484222325ull;
+    hashBytes(path_hash, path_string.data(), path_string.size());
+    return true;
+}
+
+uint64_t hashFileContents(const std::string& file_name) {
+    MappedFile file(file_name);
+    const uint8_t* bytes = file.data();
+    size_t size = file.size(), word_cnt = size / sizeof(uint64_t);
+    // FNV-1a over 64-bit words, then over the remaining bytes
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < word_cnt; i++) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    hashBytes(hash, bytes + word_cnt * sizeof(uint64_t), size - word_cnt * sizeof(uint64_t));
+    return hash;
+}
+
+/**
+ * @brief 将头部与网格数据写入缓存文件。
+ * @note 先写入唯一的临时文件再重命名，并发的读者不会看到写了一半的缓存，并发的写者也不会共用临时文件。
+ */
+static bool saveMeshCache(const std::string& cache_file, const MeshCacheHeader& header, const MeshData& mesh) {
+    std::string temp_file = utils::temporaryFileName(cache_file);
+    {
+        std::ofstream file(temp_file, std::ios::binary);
+        if (!file) {
+            printf("Failed to write the mesh cache: %s\n", cache_file.c_str());
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(mesh.positions.data()), sizeof(float) * mesh.positions.size());
+        file.write(reinterpret_cast<const char*>(mesh.normals.data()), sizeof(float) * mesh.normals.size());
+        file.write(reinterpret_cast<const char*>(mesh.uvs.data()), sizeof(float) * mesh.uvs.size());
+        file.write(reinterpret_cast<const char*>(mesh.indices.data()), sizeof(uint32_t) * mesh.indices.size());
+        file.close();
+        if (!file) {
+            std::error_code error;
+            std::filesystem::remove(temp_file, error);
+            printf("Failed to write the mesh cache: %s\n", cache_file.c_str());
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp_file, cache_file, error);
+    if (error) {
+        std::filesystem::remove(temp_file, error);
+        printf("Failed to write the mesh cache: %s\n", cache_file.c_str());
+        return false;
+    }
+    printf("Saved the mesh cache to %s\n", cache_file.c_str());
+    return true;
+}
+
+uint64_t hashMeshSource(const std::string& source_file) {
+    uint64_t path_hash, source_size;
+    int64_t source_mtime;
+    if (sourceStamp(source_file, path_hash, source_size, source_mtime)) {
+        // Only the header of the cache is read, the stamp tells whether its hash is still valid
+        MeshCacheHeader header;
+        std::ifstream file(source_file + MESH_CACHE_EXTENSION, std::ios::binary);
+        if (file.read(reinterpret_cast<char*>(&header), sizeof(header))
+            && header.magic == MESH_FILE_MAGIC && header.version == MESH_FILE_VERSION && header.path_hash == path_hash
+            && header.source_size == source_size && header.source_mtime == source_mtime) {
+            return header.source_hash;
+        }
+    }
+    return hashFileContents(source_file);
+}
+
+bool readMeshCache(const std::string& source_file, MeshData& mesh, uint64_t source_hash) {
+    std::string cache_file = source_file + MESH_CACHE_EXTENSION;
+    uint64_t path_hash, source_size;
+    int64_t source_mtime;
+    if (!sourceStamp(source_file, path_hash, source_size, source_mtime)) {
+        return false;
+    }
+    MappedFile cache(cache_file);
+    if (!cache.data()) {
+        return false;
+    }
+
+    // 1. Validate the header and the size of the payload
+    MeshCacheHeader header;
+    if (cache.size() < sizeof(header)) {
+        printf("Mesh cache %s is truncated, reloading the source\n", cache_file.c_str());
+        return false;
+    }
+    std::memcpy(&header, cache.data(), sizeof(header));
+    size_t vertex_bytes = static_cast<size_t>(header.vertex_cnt) * (4 + 3 + 2) * sizeof(float),
+        index_bytes = static_cast<size_t>(header.index_cnt) * sizeof(uint32_t);
+    if (header.magic != MESH_FILE_MAGIC || header.version != MESH_FILE_VERSION
+        || cache.size() != sizeof(header) + vertex_bytes + index_bytes || header.index_cnt % 3 != 0) {
+        printf("Mesh cache %s is invalid, reloading the source\n", cache_file.c_str());
+        return false;
+    }
+    if (header.path_hash != path_hash || header.source_size != source_size) {
+        printf("Mesh cache %s is stale, reloading the source\n", cache_file.c_str());
+        return false;
+    }
+
+    // 2. A different mtime alone does not invalidate the cache if the contents are unchanged
+    bool restamp = header.source_mtime != source_mtime;
+    if (header.source_hash != source_hash) {
+        printf("Mesh cache %s is stale, reloading the source\n", cache_file.c_str());
+        return false;
+    }
+
+    // 3. The blocks are stored in the in-memory layout, copy them out of the mapping
+    //    The indices are checked first: every later stage indexes the vertex blocks with them unchecked
+    const uint8_t* data = cache.data() + sizeof(header);
+    std::vector<uint32_t> indices(header.index_cnt);
+    std::memcpy(indices.data(), data + vertex_bytes, index_bytes);
+    for (uint32_t index : indices) {
+        if (index >= header.vertex_cnt) {
+            printf("Mesh cache %s has an index out of range, reloading the source\n", cache_file.c_str());
+            return false;
+        }
+    }
+    mesh.positions.resize(4, header.vertex_cnt);
+    mesh.normals.resize(3, header.vertex_cnt);
+    mesh.uvs.resize(2, header.vertex_cnt);
+    std::memcpy(mesh.positions.data(), data, sizeof(float) * mesh.positions.size());
+    data += sizeof(float) * mesh.positions.size();
+    std::memcpy(mesh.normals.data(), data, sizeof(float) * mesh.normals.size());
+    data += sizeof(float) * mesh.normals.size();
+    std::memcpy(mesh.uvs.data(), data, sizeof(float) * mesh.uvs.size());
+    mesh.indices = std::move(indices);
+    mesh.min_bound = Vec3f(header.min_bound[0], header.min_bound[1], header.min_bound[2]);
+    mesh.max_bound = Vec3f(header.max_bound[0], header.max_bound[1], header.max_bound[2]);
+    printf("Loaded the mesh cache %s\n", cache_file.c_str());
+
+    // 4. Rewrite the cache with the new mtime, so that the contents are not hashed again next time
+    if (restamp) {
+        header.source_mtime = source_mtime;
+        saveMeshCache(cache_file, header, mesh);
+    }
+    return true;
+}
+
+bool writeMeshCache(const std::string& source_file, const MeshData& mesh, uint64_t source_hash) {
+    MeshCacheHeader header = {};
+    header.magic = MESH_FILE_MAGIC;
+    header.version = MESH_FILE_VERSION;
+    if (!sourceStamp(source_file, header.path_hash, header.source_size, header.source_mtime)) {
+        return false;
+    }
+    header.source_hash = source_hash;
+    header.vertex_cnt = mesh.positions.cols();
+    header.index_cnt = mesh.indices.size();
+    for (int a = 0; a < 3; a++) {
+        header.min_bound[a] = mesh.min_bound[a];
+        header.max_bound[a] = mesh.max_bound[a];
+    }
+    return saveMeshCache(source_file + MESH_CACHE_EXTENSION, header, mesh);
+}
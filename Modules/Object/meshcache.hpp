@@ -0,0 +1,66 @@
+#ifndef MESHCACHE_HPP_
+#define MESHCACHE_HPP_
+
+#include "utils.hpp"
+#include <cstdint>
+
+/*
+Mesh Cache
+    A binary copy of a loaded mesh, written next to the source file as <source>MESH_CACHE_EXTENSION.
+    The file is a fixed header followed by the attribute blocks exactly as Object keeps them
+    in memory, so loading it is a check of the sizes and the indices and a memcpy out of a
+    read-only mmap:
+        header      magic, version, key, vertex and index counts, local bounds
+        positions   4 floats per vertex (homogeneous, w = 1)
+        normals     3 floats per vertex
+        uvs         2 floats per vertex
+        indices     uint32 per triangle corner, ordered for the vertex cache and oriented after the normals
+
+    The key is the hash of the source path, the source size and mtime, and the hash of the
+    source contents. The contents hash doubles as the asset key of the mesh (see AssetCache):
+    while path, size and mtime match, it is taken from the header and the source is not read.
+    Path, size and mtime are checked first; when only the mtime differs
+    (the file was touched or copied), the contents are hashed and, if they match, the cache is kept
+    and rewritten with the new mtime. Every write goes through a temporary file and a rename.
+*/
+
+struct MeshData {
+    Mat4Xf positions;
+    Mat3Xf normals;
+    Mat2Xf uvs;
+    std::vector<uint32_t> indices;
+    Vec3f min_bound = Vec3f::Zero(), max_bound = Vec3f::Zero();
+};
+
+/**
+ * @brief 读取源文件对应的网格缓存。
+ * @param source_file 源网格文件的路径。
+ * @param mesh 输出的网格数据。
+ * @param source_hash 源文件内容的哈希值，由 hashMeshSource 得到。
+ * @return 缓存存在、格式正确且与源文件一致时返回 true，否则 mesh 保持不变。
+ */
+bool readMeshCache(const std::string& source_file, MeshData& mesh, uint64_t source_hash);
+
+/**
+ * @brief 将网格写入源文件旁的缓存文件。
+ * @param source_file 源网格文件的路径。
+ * @param mesh 由源文件解析得到的网格数据。
+ * @param source_hash 源文件内容的哈希值，由 hashMeshSource 得到。
+ * @return 写入成功时返回 true；目录不可写时只打印提示。
+ */
+bool writeMeshCache(const std::string& source_file, const MeshData& mesh, uint64_t source_hash);
+
+/**
+ * @brief 源网格文件内容的哈希值。
+ * @note 缓存头部记录的路径、大小与修改时间与源文件一致时直接返回头部中的哈希值，只读取头部；
+ *       否则读取源文件计算 hashFileContents。
+ */
+uint64_t hashMeshSource(const std::string& source_file);
+
+/**
+ * @brief 文件内容的哈希值（按 64 位字的 FNV-1a），通过 mmap 读取。
+ * @note 文件不存在或为空时返回初始哈希值。
+ */
+uint64_t hashFileContents(const std::string& file_name);
+
+#endif // MESHCACHE_HPP_
@@ -1,16 +1,71 @@
 #include "object.hpp"
+#include "vertexcache.hpp"
+#include "meshcache.hpp"
+#include <map>
+#include <tuple>
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
 /**
- * @brief 从文件加载对象并解析为三角形列表。
+ * @brief 三角形的几何朝向是否与其顶点法线相反。
+ * @param positions, normals 同一坐标系下的顶点位置与法线。
+ * @param tri 三角形的三个顶点索引。
+ */
+static bool isWindingFlipped(const Mat3Xf& positions, const Mat3Xf& normals, const uint32_t* tri) {
+    Vec3f face_normal = (positions.col(tri[1]) - positions.col(tri[0])).cross(positions.col(tri[2]) - positions.col(tri[0]));
+    return face_normal.dot(normals.col(tri[0]) + normals.col(tri[1]) + normals.col(tri[2])) < 0;
+}
+
+/**
+ * @brief 用一次 printf 打印标题与包围盒，并行加载与变换的对象的日志不会交错。
+ */
+static void printBounds(const std::string& title, const Vec3f& min_bound, const Vec3f& max_bound, const Vec3f& center) {
+    printf("%s\nMin Bound: %f %f %f \nMax Bound: %f %f %f \nCenter: %f %f %f \n", title.c_str(),
+        min_bound.x(), min_bound.y(), min_bound.z(), max_bound.x(), max_bound.y(), max_bound.z(),
+        center.x(), center.y(), center.z());
+}
+
+/**
+ * @brief 从文件加载对象。
  * @param file_name 要加载的对象文件路径。
- * @note 该函数使用 tinyobjloader 库解析 .obj 文件，仅支持三角形面片。
- *       如果文件中包含非三角形面片，将抛出异常。
+ * @note 网格只属于该对象；需要在多个对象间共享网格时使用 AssetCache 与实例化构造函数。
  */
 void Object::loadObject(const std::string& file_name) {
+    mesh = loadMesh(file_name, hashMeshSource(file_name));
+    oriented_indices.clear();
+    center_local = (mesh->min_bound + mesh->max_bound) / 2;
+}
+
+/**
+ * @brief 从文件加载不可变的网格。
+ * @param file_name 要加载的对象文件路径。
+ * @param source_hash 文件内容的哈希值（见 hashMeshSource），用于校验与写入缓存，避免再次读取源文件。
+ * @note 优先读取源文件旁的二进制网格缓存（见 meshcache.hpp），缓存缺失或过期时解析源文件并重新写入缓存。
+ */
+std::shared_ptr<const MeshData> Object::loadMesh(const std::string& file_name, uint64_t source_hash) {
     printf("Loading Object: %s\n", file_name.c_str());
 
+    std::shared_ptr<MeshData> mesh = std::make_shared<MeshData>();
+    if (!readMeshCache(file_name, *mesh, source_hash)) {
+        parseObject(file_name, *mesh);
+        writeMeshCache(file_name, *mesh, source_hash);
+    }
+
+    // Print the min_bound and max_bound of the object
+    printBounds("Object Loaded Successfully: " + file_name, mesh->min_bound, mesh->max_bound,
+        (mesh->min_bound + mesh->max_bound) / 2);
+    return mesh;
+}
+
+/**
+ * @brief 解析 .obj 文件为索引三角形网格。
+ * @param file_name 要解析的对象文件路径。
+ * @param mesh 输出的网格数据。
+ * @note 该函数使用 tinyobjloader 库解析 .obj 文件，仅支持三角形面片。
+ *       如果文件中包含非三角形面片，将抛出异常。
+ *       位置、法线、纹理坐标索引都相同的顶点只保存一次，索引按顶点缓存复用率重排。
+ */
+void Object::parseObject(const std::string& file_name, MeshData& mesh) {
     /*
     Use tinyobjloader to load the object file
         Reference: https://blog.csdn.net/qjh5606/article/details/89075014
@@ -24,13 +79,14 @@ void Object::loadObject(const std::string& file_name) {
         throw std::runtime_error(warn + err);
     }
 
-    printf("# of vertices  = %d\n", (int)(attrib.vertices.size()) / 3);
-    printf("# of normals   = %d\n", (int)(attrib.normals.size()) / 3);
-    printf("# of texcoords = %d\n", (int)(attrib.texcoords.size()) / 2);
-    printf("# of shapes    = %d\n", (int)shapes.size());
-    printf("# of materials = %d\n", (int)materials.size());
+    // One printf per message, so that the logs of meshes parsed concurrently do not interleave
+    printf("# of vertices  = %d\n# of normals   = %d\n# of texcoords = %d\n# of shapes    = %d\n# of materials = %d\n",
+        (int)(attrib.vertices.size()) / 3, (int)(attrib.normals.size()) / 3, (int)(attrib.texcoords.size()) / 2,
+        (int)shapes.size(), (int)materials.size());
 
-    // Load all vertex data
+    // Load all vertex data, a vertex is identified by its (position, normal, texcoord) indices
+    std::vector<Vertex> vertices;
+    std::map<std::tuple<int, int, int>, uint32_t> vertex_ids;
     for (size_t i = 0; i < shapes.size(); i++) {
         size_t index_offset = 0;
         for (size_t f = 0; f < shapes[i].mesh.num_face_vertices.size(); f++) {
@@ -41,9 +97,14 @@ void Object::loadObject(const std::string& file_name) {
                 throw std::runtime_error("Only Triangles are supported");
             }
 
-            Triangle tri;
             for (size_t v = 0; v < 3; v++) {
                 tinyobj::index_t idx = shapes[i].mesh.indices[index_offset + v];
+                auto key = std::make_tuple(idx.vertex_index, idx.normal_index, idx.texcoord_index);
+                auto found = vertex_ids.find(key);
+                if (found != vertex_ids.end()) {
+                    mesh.indices.push_back(found->second);
+                    continue;
+                }
                 Vec3f position_ (
                     attrib.vertices[3 * idx.vertex_index + 0],
                     attrib.vertices[3 * idx.vertex_index + 1],
@@ -66,84 +127,86 @@ void Object::loadObject(const std::string& file_name) {
                     );
                 }
                 // Update the min_bound and max_bound
-                if (triangles_local.size() == 0) {
-                    min_bound_local = position_;
-                    max_bound_local = position_;
+                if (vertices.size() == 0) {
+                    mesh.min_bound = position_;
+                    mesh.max_bound = position_;
                 } else {
-                    min_bound_local = min_bound_local.cwiseMin(position_);
-                    max_bound_local = max_bound_local.cwiseMax(position_);
+                    mesh.min_bound = mesh.min_bound.cwiseMin(position_);
+                    mesh.max_bound = mesh.max_bound.cwiseMax(position_);
                 }
 
-                Vertex vert(position_, normal_, texcoord_);
-                tri.setVertex(v, vert);
+                vertex_ids.emplace(key, vertices.size());
+                mesh.indices.push_back(vertices.size());
+                vertices.emplace_back(position_, normal_, texcoord_);
             }
-            addTriangleLocal(tri);
             index_offset += 3;
         }
     }
-    
-    // Calculate the center
-    center_local = (min_bound_local + max_bound_local) / 2;
 
-    puts("Object Loaded Successfully");
-    // Print the min_bound and max_bound of the object
-    printf("Min Bound: ");
-    utils::printVec(min_bound_local);
-    printf("Max Bound: ");
-    utils::printVec(max_bound_local);
-    printf("Center: ");
-    utils::printVec(center_local);
+    // Reorder the triangles for vertex reuse, then the vertices in order of first use
+    uint32_t vertex_cnt = vertices.size();
+    float acmr_before = computeACMR(mesh.indices, vertex_cnt);
+    optimizeVertexCache(mesh.indices, vertex_cnt);
+    optimizeVertexFetch(vertices, mesh.indices);
+    printf("# of unique vertices = %d, triangles = %d\nVertex Cache ACMR: %.3f -> %.3f\n",
+        vertex_cnt, (int)(mesh.indices.size() / 3), acmr_before, computeACMR(mesh.indices, vertex_cnt));
+
+    // Store the attributes as blocks, so that a view transforms all positions in one matrix product
+    mesh.positions.resize(4, vertex_cnt);
+    mesh.normals.resize(3, vertex_cnt);
+    mesh.uvs.resize(2, vertex_cnt);
+    for (uint32_t v = 0; v < vertex_cnt; v++) {
+        mesh.positions.col(v) = vertices[v].position.homogeneous();
+        mesh.normals.col(v) = vertices[v].normal;
+        mesh.uvs.col(v) = vertices[v].uv;
+    }
+
+    // Orient the winding after the vertex normals in local space, so that instances
+    // under transforms that keep the orientation can share the indices
+    Mat3Xf positions = mesh.positions.topRows<3>();
+    for (size_t t = 0; t < mesh.indices.size(); t += 3) {
+        if (isWindingFlipped(positions, mesh.normals, &mesh.indices[t])) {
+            std::swap(mesh.indices[t + 1], mesh.indices[t + 2]);
+        }
+    }
 }
 
 /**
- * @brief 将对象从局部空间转换到世界空间。
+ * @brief 设置对象的模型矩阵。
  * @param model_mat 模型矩阵，用于将局部坐标转换为世界坐标。
- * @note 该函数会更新对象的三角形列表、包围盒和中心点。
- *       顶点法线也会根据模型矩阵进行变换。
+ * @note 该函数只更新模型矩阵、法线矩阵、世界空间包围盒和中心点，顶点数据仍保存在局部空间，
+ *       由渲染时的模型-视图-投影矩阵一次变换到裁剪空间。
  */
 void Object::localToWorld(const Mat4f& model_mat) {
-    // Clear Old triangles
-    triangles.clear();
-    // Apply Transformation
     model_matrix = model_mat;
-    for (Triangle tri : triangles_local) {
-        // Apply Transformation to Each Vertex's Position
-        for (int i = 0; i < 3; i++) {
-            Vertex vert = tri.getVertex(i);
-            Vec4f pos(vert.position.x(), vert.position.y(), vert.position.z(), 1);
-            Vec4f new_pos = model_mat * pos;
-            vert.position = Vec3f(new_pos.x(), new_pos.y(), new_pos.z());
-            tri.setVertex(i, vert);
-        }
-        // Apply Transformation to Each Vertex's Normal
-        for (int i = 0; i < 3; i++) {
-            Vertex vert = tri.getVertex(i);
-            Vec4f norm(vert.normal.x(), vert.normal.y(), vert.normal.z(), 0);
-            Vec4f new_norm = model_mat * norm;
-            vert.normal = Vec3f(new_norm.x(), new_norm.y(), new_norm.z());
-            tri.setVertex(i, vert);
-
-            // Update the min_bound and max_bound
-            if (triangles.size() == 0) {
-                min_bound = vert.position;
-                max_bound = vert.position;
-            } else {
-                min_bound = min_bound.cwiseMin(vert.position);
-                max_bound = max_bound.cwiseMax(vert.position);
+    // Normals are transformed by the inverse transpose, which keeps them perpendicular under non-uniform scaling
+    normal_matrix = model_mat.topLeftCorner<3, 3>().inverse().transpose();
+
+    // Update the min_bound and max_bound
+    Mat3Xf positions = model_mat.topRows<3>() * mesh->positions;
+    if (positions.cols() > 0) {
+        min_bound = positions.rowwise().minCoeff();
+        max_bound = positions.rowwise().maxCoeff();
+    }
+
+    // Orient the winding after the vertex normals, so that back-face culling can
+    // tell the front side from the screen space winding alone
+    // The indices are shared with the other instances of the mesh, a private copy is made
+    // only when this transform needs a different winding, e.g. when it mirrors the mesh
+    Mat3Xf normals = normal_matrix * mesh->normals;
+    const std::vector<uint32_t>& shared_indices = mesh->indices;
+    oriented_indices.clear();
+    for (size_t t = 0; t < shared_indices.size(); t += 3) {
+        if (isWindingFlipped(positions, normals, &shared_indices[t])) {
+            if (oriented_indices.empty()) {
+                oriented_indices = shared_indices;
             }
+            std::swap(oriented_indices[t + 1], oriented_indices[t + 2]);
         }
-        // Add Triangle to triangles
-        addTriangle(tri);
     }
 
     // Calculate the center
     center = (min_bound + max_bound) / 2;
     // Print the min_bound and max_bound of the object
-    puts("Apply Transformation Successfully");
-    printf("Min Bound: ");
-    utils::printVec(min_bound);
-    printf("Max Bound: ");
-    utils::printVec(max_bound);
-    printf("Center: ");
-    utils::printVec(center);
-}
\ No newline at end of file
+    printBounds("Apply Transformation Successfully", min_bound, max_bound, center);
+}
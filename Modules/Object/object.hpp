@@ -3,43 +3,59 @@
 
 #include "geometry.hpp"
 #include "materials.hpp"
+#include "meshcache.hpp"
 
 class Object {
-    /* Raw Data in Local Space */
-    std::vector<Triangle> triangles_local;
-    Vec3f min_bound_local, max_bound_local, center_local;
+    /* Raw Data in Local Space: an indexed mesh, three indices per triangle, see MeshData.
+       The mesh is immutable and shared by all instances of the same source file. */
+    std::shared_ptr<const MeshData> mesh;
+    std::vector<uint32_t> oriented_indices; // private winding of this instance, empty when it matches the mesh
+    Vec3f center_local;
 
-    /* Data for Rendering */
+    /* Data for Rendering: the mesh is transformed on the fly, only the matrices and bounds are kept */
     Mat4f model_matrix;
-    std::vector<Triangle> triangles;
+    Mat3f normal_matrix;
     Vec3f min_bound, max_bound, center;
 
     /* Material */
     std::shared_ptr<Materials> material;
 
-    void addTriangleLocal(Triangle tri) { triangles_local.push_back(tri); }
-
 public:
-    Object() : model_matrix(Mat4f::Identity()), material(nullptr) {};
-    Object(const std::string& file_name) : model_matrix(Mat4f::Identity()), material(nullptr) {
+    Object() : mesh(std::make_shared<MeshData>()), model_matrix(Mat4f::Identity()), normal_matrix(Mat3f::Identity()), material(nullptr) {};
+    Object(const std::string& file_name) : model_matrix(Mat4f::Identity()), normal_matrix(Mat3f::Identity()), material(nullptr) {
         loadObject(file_name);
     };
-    Object(const std::string& file_name, std::shared_ptr<Materials> mat) : model_matrix(Mat4f::Identity()), material(mat) {
+    Object(const std::string& file_name, std::shared_ptr<Materials> mat)
+        : model_matrix(Mat4f::Identity()), normal_matrix(Mat3f::Identity()), material(mat) {
         loadObject(file_name);
     };
+    // Instance of a loaded mesh: only the matrices, the bounds and the material are owned
+    Object(std::shared_ptr<const MeshData> mesh, std::shared_ptr<Materials> mat = nullptr)
+        : mesh(mesh), center_local((mesh->min_bound + mesh->max_bound) / 2),
+          model_matrix(Mat4f::Identity()), normal_matrix(Mat3f::Identity()), material(mat) {};
 
     /* Modify Functions */
-    void addTriangle(Triangle tri) { triangles.push_back(tri); }
     void loadObject(const std::string& file_name);
-    void setMaterial(std::shared_ptr<Materials> mat) { material = mat; }
+    static std::shared_ptr<const MeshData> loadMesh(const std::string& file_name, uint64_t source_hash);
+    static void parseObject(const std::string& file_name, MeshData& mesh);
+    void setMaterial(std::shared_ptr<Materials> mat) { material = std::move(mat); }
 
     /* Transform Functions */
     void localToWorld(const Mat4f& model_mat);
 
     /* Getters */
-    std::vector<Triangle> getTriangles() { return triangles; }
-    Mat4f getModelMatrix() { return model_matrix; }
-    std::shared_ptr<Materials> getMaterial() { return material; }
+    const std::shared_ptr<const MeshData>& getMesh() const { return mesh; }
+    const Mat4Xf& getPositions() const { return mesh->positions; }
+    const Mat3Xf& getNormals() const { return mesh->normals; }
+    const Mat2Xf& getUVs() const { return mesh->uvs; }
+    const std::vector<uint32_t>& getIndices() const { return oriented_indices.empty() ? mesh->indices : oriented_indices; }
+    size_t getVertexCount() const { return mesh->positions.cols(); }
+    size_t getTriangleCount() const { return mesh->indices.size() / 3; }
+    const Mat4f& getModelMatrix() const { return model_matrix; }
+    const Mat3f& getNormalMatrix() const { return normal_matrix; }
+    const std::shared_ptr<Materials>& getMaterial() const { return material; }
+    Vec3f getMinBound() const { return min_bound; }
+    Vec3f getMaxBound() const { return max_bound; }
 };
 
 #endif // OBJECT_HPP_
\ No newline at end of file
@@ -7,17 +7,41 @@
 class Scene {
     std::vector<std::shared_ptr<Light>> lights;
     std::vector<std::shared_ptr<Object>> objects;
+    /* Material Table, indexed by the 16-bit material id of the G-Buffer */
+    std::vector<std::shared_ptr<Materials>> materials;
 public:
     Scene() {
         objects.clear();
         lights.clear();
     }
     /* Modify Functions */
-    void addObject(std::shared_ptr<Object> obj) { objects.push_back(obj); }
-    void addLight(std::shared_ptr<Light> light) { lights.push_back(light); }
-    /* Getters */
-    std::vector<std::shared_ptr<Object>> getObjects() const { return objects; }
-    std::vector<std::shared_ptr<Light>> getLights() const { return lights; }
+    void addObject(std::shared_ptr<Object> obj) { objects.push_back(std::move(obj)); }
+    void addLight(std::shared_ptr<Light> light) { lights.push_back(std::move(light)); }
+    uint16_t addMaterial(std::shared_ptr<Materials> mat) {
+        // Each material is stored once
+        uint16_t id = getMaterialId(mat);
+        if (id != MATERIAL_NONE || mat == nullptr) {
+            return id;
+        }
+        if (materials.size() >= MATERIAL_NONE) {
+            puts("Too Many Materials");
+            exit(1);
+        }
+        materials.push_back(mat);
+        return materials.size() - 1;
+    }
+    /* Getters: views into the scene, valid until the next add */
+    const std::vector<std::shared_ptr<Object>>& getObjects() const { return objects; }
+    const std::vector<std::shared_ptr<Light>>& getLights() const { return lights; }
+    const std::shared_ptr<Materials>& getMaterial(uint16_t id) const { return materials[id]; }
+    uint16_t getMaterialId(const std::shared_ptr<Materials>& mat) const {
+        for (size_t i = 0; i < materials.size(); i++) {
+            if (materials[i] == mat) {
+                return i;
+            }
+        }
+        return MATERIAL_NONE;
+    }
 };
 
 #endif // SCENE_HPP_
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "vertexcache.hpp"
+#include <algorithm>
+
+/**
+ * @brief Forsyth 算法中顶点的得分。
+ * @param cache_pos 顶点在 LRU 缓存中的位置，不在缓存中时为 -1。
+ * @param remaining 顶点尚未输出的相邻三角形数。
+ */
+static float vertexScore(int cache_pos, uint32_t remaining) {
+    if (remaining == 0) {
+        return -1;
+    }
+    float score = 0;
+    if (cache_pos >= 0) {
+        // The last triangle's vertices get a fixed score, so that strips are not forced
+        score = (cache_pos < 3)
+            ? 0.75f
+            : std::pow(1 - (cache_pos - 3) / static_cast<float>(VERTEX_CACHE_SIZE - 3), 1.5f);
+    }
+    // Favour vertices with few triangles left, so that they leave the mesh early
+    score += 2.0f / std::sqrt(static_cast<float>(remaining));
+    return score;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertex_count) {
+    uint32_t triangle_cnt = indices.size() / 3;
+    if (triangle_cnt == 0) {
+        return;
+    }
+
+    // 1. Vertex to triangle adjacency, the first remaining[v] entries of v are not emitted yet
+    std::vector<uint32_t> remaining(vertex_count, 0), adjacency_begin(vertex_count + 1, 0);
+    for (uint32_t idx : indices) {
+        remaining[idx]++;
+    }
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        adjacency_begin[v + 1] = adjacency_begin[v] + remaining[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size()), fill(adjacency_begin.begin(), adjacency_begin.end() - 1);
+    for (uint32_t t = 0; t < triangle_cnt; t++) {
+        for (int i = 0; i < 3; i++) {
+            adjacency[fill[indices[3 * t + i]]++] = t;
+        }
+    }
+
+    // 2. Initial scores
+    std::vector<int> cache_pos(vertex_count, -1);
+    std::vector<float> vertex_score(vertex_count), triangle_score(triangle_cnt);
+    for (uint32_t v = 0; v < vertex_count; v++) {
+        vertex_score[v] = vertexScore(-1, remaining[v]);
+    }
+    int64_t best = 0;
+    for (uint32_t t = 0; t < triangle_cnt; t++) {
+        triangle_score[t] = vertex_score[indices[3 * t]] + vertex_score[indices[3 * t + 1]] + vertex_score[indices[3 * t + 2]];
+        if (triangle_score[t] > triangle_score[best]) {
+            best = t;
+        }
+    }
+
+    // 3. Greedily emit the best scored triangle among those touching the cache
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    std::vector<uint8_t> emitted(triangle_cnt, 0);
+    std::vector<uint32_t> cache, new_cache;
+    cache.reserve(VERTEX_CACHE_SIZE + 3), new_cache.reserve(VERTEX_CACHE_SIZE + 3);
+    uint32_t scan_cursor = 0;
+    for (uint32_t n = 0; n < triangle_cnt; n++) {
+        if (best < 0) {
+            // No candidate in the cache, continue with the next triangle in the input order
+            while (emitted[scan_cursor]) {
+                scan_cursor++;
+            }
+            best = scan_cursor;
+        }
+        emitted[best] = 1;
+        const uint32_t* tri = &indices[3 * best];
+        output.insert(output.end(), tri, tri + 3);
+
+        // Remove the triangle from the adjacency of its vertices
+        for (int i = 0; i < 3; i++) {
+            uint32_t v = tri[i];
+            uint32_t* adj = &adjacency[adjacency_begin[v]];
+            std::swap(*std::find(adj, adj + remaining[v], static_cast<uint32_t>(best)), adj[remaining[v] - 1]);
+            remaining[v]--;
+        }
+
+        // Move the triangle's vertices to the front of the LRU cache
+        new_cache.assign(tri, tri + 3);
+        for (uint32_t v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2]) {
+                new_cache.push_back(v);
+            }
+        }
+        for (size_t i = 0; i < new_cache.size(); i++) {
+            uint32_t v = new_cache[i];
+            cache_pos[v] = (i < VERTEX_CACHE_SIZE) ? static_cast<int>(i) : -1;
+            vertex_score[v] = vertexScore(cache_pos[v], remaining[v]);
+        }
+
+        // Rescore the triangles touching the cache and pick the next one
+        best = -1;
+        float best_score = -1;
+        for (uint32_t v : new_cache) {
+            for (uint32_t k = 0; k < remaining[v]; k++) {
+                uint32_t t = adjacency[adjacency_begin[v] + k];
+                const uint32_t* tv = &indices[3 * t];
+                triangle_score[t] = vertex_score[tv[0]] + vertex_score[tv[1]] + vertex_score[tv[2]];
+                if (triangle_score[t] > best_score) {
+                    best_score = triangle_score[t];
+                    best = t;
+                }
+            }
+        }
+        if (new_cache.size() > VERTEX_CACHE_SIZE) {
+            new_cache.resize(VERTEX_CACHE_SIZE);
+        }
+        std::swap(cache, new_cache);
+    }
+    // The greedy order can lose to an input that is already in strip order, e.g. fan triangulated quads
+    if (computeACMR(output, vertex_count) < computeACMR(indices, vertex_count)) {
+        indices.swap(output);
+    }
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+    const uint32_t unused = UINT32_MAX;
+    std::vector<uint32_t> remap(vertices.size(), unused);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (uint32_t& idx : indices) {
+        if (remap[idx] == unused) {
+            remap[idx] = reordered.size();
+            reordered.push_back(vertices[idx]);
+        }
+        idx = remap[idx];
+    }
+    vertices.swap(reordered);
+}
+
+float computeACMR(const std::vector<uint32_t>& indices, uint32_t vertex_count, int cache_size) {
+    if (indices.empty()) {
+        return 0;
+    }
+    // FIFO cache: a vertex is in the cache if it was inserted less than cache_size misses ago
+    std::vector<int64_t> inserted(vertex_count, INT64_MIN / 2);
+    int64_t misses = 0;
+    for (uint32_t idx : indices) {
+        if (misses - inserted[idx] >= cache_size) {
+            inserted[idx] = misses++;
+        }
+    }
+    return static_cast<float>(misses) / (indices.size() / 3);
+}
@@ -0,0 +1,36 @@
+#ifndef VERTEXCACHE_HPP_
+#define VERTEXCACHE_HPP_
+
+#include "geometry.hpp"
+#include <cstdint>
+
+/*
+Vertex Cache Optimization
+    Reorders the index buffer of an indexed triangle mesh so that consecutive triangles
+    share vertices (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"), then renumbers
+    the vertices in order of first use so that the vertex buffer is read front to back.
+    The pipeline transforms each unique vertex once per view and assembles triangles by index,
+    both orderings keep that assembly cache friendly.
+*/
+
+/**
+ * @brief 按顶点缓存复用率重排索引缓冲区。
+ * @param indices 三角形索引，每三个为一个三角形，原地重排（三角形内部的顶点顺序不变）。
+ * @param vertex_count 顶点数。
+ * @note 重排后的 ACMR 不低于原顺序时保留原顺序。
+ */
+void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertex_count);
+
+/**
+ * @brief 按首次使用的顺序重排顶点缓冲区，并更新索引，未被引用的顶点会被删除。
+ */
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+/**
+ * @brief 计算平均缓存未命中率（ACMR，每个三角形的顶点变换次数）。
+ * @param cache_size 模拟的 FIFO 顶点缓存大小。
+ * @return 取值在 [0.5, 3] 之间，越小越好。
+ */
+float computeACMR(const std::vector<uint32_t>& indices, uint32_t vertex_count, int cache_size = VERTEX_CACHE_SIZE);
+
+#endif // VERTEXCACHE_HPP_
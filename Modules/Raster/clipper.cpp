@@ -0,0 +1,111 @@
+#include "clipper.hpp"
+#include <algorithm>
+
+/* Frustum planes, a clip space point p is inside when plane.dot(p) >= 0 */
+static const Vec4f FRUSTUM_PLANES[6] = {
+    Vec4f(0, 0, -1, 1), // Near: z <= w
+    Vec4f(0, 0, 1, 1),  // Far: -w <= z
+    Vec4f(-1, 0, 0, 1), // Right
+    Vec4f(1, 0, 0, 1),  // Left
+    Vec4f(0, -1, 0, 1), // Top
+    Vec4f(0, 1, 0, 1)   // Bottom
+};
+
+bool isBoxOutsideFrustum(const Mat4f& view_projection, const Vec3f& min_bound, const Vec3f& max_bound) {
+    Vec4f corners[8];
+    for (int i = 0; i < 8; i++) {
+        Vec3f corner(
+            (i & 1) ? max_bound.x() : min_bound.x(),
+            (i & 2) ? max_bound.y() : min_bound.y(),
+            (i & 4) ? max_bound.z() : min_bound.z()
+        );
+        corners[i] = view_projection * corner.homogeneous();
+    }
+    for (const Vec4f& plane : FRUSTUM_PLANES) {
+        bool all_outside = true;
+        for (int i = 0; i < 8 && all_outside; i++) {
+            all_outside = plane.dot(corners[i]) < 0;
+        }
+        if (all_outside) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TriangleClipper::TriangleClipper(int width, int height) {
+    // RASTER_GUARD_BAND pixels on each side of the screen, in NDC
+    guard_x = 1 + 2.0f * RASTER_GUARD_BAND / width;
+    guard_y = 1 + 2.0f * RASTER_GUARD_BAND / height;
+}
+
+/**
+ * @brief 用一个平面裁剪凸多边形（Sutherland-Hodgman）。
+ * @return 裁剪后的顶点数。
+ */
+static int clipPolygon(const Vec4f& plane, const ClipVertex* in, int in_cnt, ClipVertex* out) {
+    int out_cnt = 0;
+    for (int i = 0; i < in_cnt; i++) {
+        const ClipVertex& cur = in[i];
+        const ClipVertex& next = in[(i + 1) % in_cnt];
+        float d_cur = plane.dot(cur.position), d_next = plane.dot(next.position);
+        if (d_cur >= 0) {
+            out[out_cnt++] = cur;
+        }
+        if ((d_cur >= 0) != (d_next >= 0)) {
+            // The edge crosses the plane, add the intersection
+            float t = d_cur / (d_cur - d_next);
+            out[out_cnt++] = {
+                cur.position + t * (next.position - cur.position),
+                cur.weights + t * (next.weights - cur.weights)
+            };
+        }
+    }
+    return out_cnt;
+}
+
+int TriangleClipper::clip(const Vec4f clip[3], ClipVertex out[RASTER_MAX_CLIP_VERTICES]) const {
+    // 1. Trivial Rejection: all vertices outside the same frustum plane
+    uint32_t outcode_and = (1 << 6) - 1, outcode_or = 0;
+    for (int i = 0; i < 3; i++) {
+        uint32_t outcode = 0;
+        for (int p = 0; p < 6; p++) {
+            if (FRUSTUM_PLANES[p].dot(clip[i]) < 0) {
+                outcode |= 1 << p;
+            }
+        }
+        outcode_and &= outcode, outcode_or |= outcode;
+    }
+    if (outcode_and) {
+        return 0;
+    }
+
+    // 2. Select the planes to clip against: the near plane, and the guard band planes
+    //    only when a vertex is outside of them
+    const Vec4f guard_planes[4] = {
+        Vec4f(-1, 0, 0, guard_x), Vec4f(1, 0, 0, guard_x),
+        Vec4f(0, -1, 0, guard_y), Vec4f(0, 1, 0, guard_y)
+    };
+    Vec4f planes[5];
+    int plane_cnt = 0;
+    if (outcode_or & 1) {
+        planes[plane_cnt++] = FRUSTUM_PLANES[0];
+    }
+    for (const Vec4f& plane : guard_planes) {
+        if (plane.dot(clip[0]) < 0 || plane.dot(clip[1]) < 0 || plane.dot(clip[2]) < 0) {
+            planes[plane_cnt++] = plane;
+        }
+    }
+
+    // 3. Clip the polygon plane by plane
+    ClipVertex buffer[RASTER_MAX_CLIP_VERTICES];
+    out[0] = {clip[0], Vec3f(1, 0, 0)};
+    out[1] = {clip[1], Vec3f(0, 1, 0)};
+    out[2] = {clip[2], Vec3f(0, 0, 1)};
+    int cnt = 3;
+    for (int p = 0; p < plane_cnt && cnt >= 3; p++) {
+        cnt = clipPolygon(planes[p], out, cnt, buffer);
+        std::copy(buffer, buffer + cnt, out);
+    }
+    return (cnt >= 3) ? cnt : 0;
+}
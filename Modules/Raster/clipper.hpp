@@ -0,0 +1,56 @@
+#ifndef CLIPPER_HPP_
+#define CLIPPER_HPP_
+
+#include "utils.hpp"
+#include <cstdint>
+
+/*
+Triangle Clipper
+    Works on clip space positions (before the division by w), where the view frustum is
+    -w <= x, y <= w and -w <= z <= w. The near plane is z = w (NDC z = 1) in this renderer.
+
+    Triangles entirely outside one of the frustum planes are rejected. Triangles crossing
+    the near plane are clipped against it, so nothing behind the camera is ever divided by w.
+    The other planes are handled by a guard band: the rasterizer only visits pixels inside
+    the screen anyway, so triangles are clipped against the (much larger) guard band planes
+    only when they would exceed the fixed-point range of the triangle setup.
+
+    A clipped vertex is described by its clip space position and its barycentric weights with
+    respect to the input triangle, so the caller can interpolate any vertex attribute.
+*/
+
+struct ClipVertex {
+    Vec4f position; // clip space
+    Vec3f weights;  // barycentric weights w.r.t. the input triangle
+};
+
+class TriangleClipper {
+public:
+    /**
+     * @brief 按目标缓冲区的分辨率确定保护带。
+     * @param width, height 目标缓冲区的分辨率。
+     */
+    TriangleClipper(int width, int height);
+
+    /**
+     * @brief 裁剪一个三角形。
+     * @param clip 三个顶点的裁剪空间坐标。
+     * @param out 输出的凸多边形顶点，至多 RASTER_MAX_CLIP_VERTICES 个。
+     * @return 输出多边形的顶点数；三角形被剔除时返回 0，无需裁剪时返回 3 且 out 与输入相同。
+     * @note 输出多边形可按 (0, k, k + 1) 三角化，绕序与输入一致。
+     */
+    int clip(const Vec4f clip[3], ClipVertex out[RASTER_MAX_CLIP_VERTICES]) const;
+
+private:
+    float guard_x, guard_y; // guard band half extent in NDC
+};
+
+/**
+ * @brief 判断包围盒是否完全位于视锥之外。
+ * @param view_projection 将包围盒所在空间变换到裁剪空间的矩阵。
+ * @param min_bound, max_bound 轴对齐包围盒。
+ * @return 包围盒的 8 个角点都在同一视锥平面之外时返回 true（保守剔除）。
+ */
+bool isBoxOutsideFrustum(const Mat4f& view_projection, const Vec3f& min_bound, const Vec3f& max_bound);
+
+#endif // CLIPPER_HPP_
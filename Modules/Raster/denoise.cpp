@@ -0,0 +1,78 @@
+#include "denoise.hpp"
+
+/**
+ * @brief 沿一个方向的联合双边滤波。
+ * @param vertical 为 false 时沿水平方向滤波，否则沿竖直方向。
+ * @note 两个方向都按行并行处理，内层循环沿行连续访问内存：对每个偏移量 k，先在整行上累加权重。
+ */
+static void bilateralPass(
+    const std::vector<Vec3f>& src, std::vector<Vec3f>& dst,
+    const std::vector<Vec3f>& normals, const std::vector<float>& distances,
+    int width, int height, bool vertical
+) {
+    // Gaussian spatial weights, shared by all pixels
+    float spatial[2 * DENOISE_RADIUS + 1];
+    for (int k = -DENOISE_RADIUS; k <= DENOISE_RADIUS; k++) {
+        spatial[k + DENOISE_RADIUS] = std::exp(-0.5f * k * k / (DENOISE_SIGMA_SPATIAL * DENOISE_SIGMA_SPATIAL));
+    }
+
+    #pragma omp parallel
+    {
+        std::vector<Vec3f> sum(width);
+        std::vector<float> weight_sum(width);
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; y++) {
+            std::fill(sum.begin(), sum.end(), Vec3f::Zero());
+            std::fill(weight_sum.begin(), weight_sum.end(), 0.0f);
+            const Vec3f* center_normals = &normals[y * width];
+            const float* center_distances = &distances[y * width];
+            for (int k = -DENOISE_RADIUS; k <= DENOISE_RADIUS; k++) {
+                // The row of neighbours at offset k, and the range of x where they exist
+                int x_min = 0, x_max = width, offset = k;
+                if (vertical) {
+                    if (y + k < 0 || y + k >= height) {
+                        continue;
+                    }
+                    offset = k * width;
+                }
+                else {
+                    x_min = std::max(-k, 0), x_max = std::min(width - k, width);
+                }
+                const Vec3f* tap_values = &src[y * width] + offset;
+                const Vec3f* tap_normals = center_normals + offset;
+                const float* tap_distances = center_distances + offset;
+                for (int x = x_min; x < x_max; x++) {
+                    // Edge stopping: normals facing apart, and relative view distance differences
+                    // Uncovered pixels have an infinite distance and get no weight
+                    float normal_weight = std::max(center_normals[x].dot(tap_normals[x]), 0.0f);
+                    for (int p = 1; p < DENOISE_NORMAL_POWER; p *= 2) {
+                        normal_weight *= normal_weight;
+                    }
+                    float depth_diff = (tap_distances[x] - center_distances[x]) / (DENOISE_SIGMA_DEPTH * center_distances[x]);
+                    float weight = spatial[k + DENOISE_RADIUS] * normal_weight * std::exp(-0.5f * depth_diff * depth_diff);
+                    if (!(weight > 0)) {
+                        continue;
+                    }
+                    sum[x] += weight * tap_values[x];
+                    weight_sum[x] += weight;
+                }
+            }
+            for (int x = 0; x < width; x++) {
+                int idx = y * width + x;
+                // Covered pixels always weigh themselves with 1
+                dst[idx] = (weight_sum[x] > 0) ? Vec3f(sum[x] / weight_sum[x]) : src[idx];
+            }
+        }
+    }
+}
+
+void jointBilateralFilter(
+    std::vector<Vec3f>& image, const std::vector<Vec3f>& normals, const std::vector<float>& distances,
+    int width, int height
+) {
+    std::vector<Vec3f> temp(image.size());
+    // 1. Horizontal
+    bilateralPass(image, temp, normals, distances, width, height, false);
+    // 2. Vertical
+    bilateralPass(temp, image, normals, distances, width, height, true);
+}
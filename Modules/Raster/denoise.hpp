@@ -0,0 +1,41 @@
+#ifndef DENOISE_HPP_
+#define DENOISE_HPP_
+
+#include "utils.hpp"
+#include <cstdint>
+
+/*
+Screen Space Denoising
+    Stochastic shading evaluates a few randomly chosen VPLs per pixel, which leaves per-pixel
+    noise. The noise is removed by a joint (cross) bilateral filter: neighbours are averaged with
+    a Gaussian spatial weight, multiplied by weights that fall off with the difference of their
+    normals and view distances, so that the filter does not blur across geometric edges.
+
+    The filter is applied separably, a horizontal pass followed by a vertical one. This is an
+    approximation of the 2D filter, but each pass reads contiguous rows (or columns) and runs
+    in O(radius) per pixel.
+*/
+
+/**
+ * @brief 每个像素的低差异随机数（Interleaved Gradient Noise），用于在相邻像素间分散采样。
+ * @return [0, 1) 内的值。
+ */
+inline float interleavedGradientNoise(int x, int y) {
+    float f = 0.06711056f * x + 0.00583715f * y;
+    f = 52.9829189f * (f - std::floor(f));
+    return f - std::floor(f);
+}
+
+/**
+ * @brief 以法线和视距为引导的可分离联合双边滤波。
+ * @param image 待滤波的图像，原地修改。
+ * @param normals 每个像素的世界坐标系单位法线。
+ * @param distances 每个像素到相机的距离，未被覆盖的像素为 INFINITY，这些像素不参与滤波。
+ * @param width, height 图像分辨率。
+ */
+void jointBilateralFilter(
+    std::vector<Vec3f>& image, const std::vector<Vec3f>& normals, const std::vector<float>& distances,
+    int width, int height
+);
+
+#endif // DENOISE_HPP_
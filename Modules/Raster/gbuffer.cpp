@@ -0,0 +1,9 @@
+#include "gbuffer.hpp"
+
+void GBuffer::resize(int width, int height) {
+    int resolution = width * height;
+    material.assign(resolution, MATERIAL_NONE);
+    normal.assign(resolution, 0);
+    u.assign(resolution, 0);
+    v.assign(resolution, 0);
+}
@@ -0,0 +1,148 @@
+#ifndef GBUFFER_HPP_
+#define GBUFFER_HPP_
+
+#include "utils.hpp"
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+/*
+Compact G-Buffer
+    Screen space attributes in SoA layout, 10 bytes per pixel next to the depth buffer:
+        material    16-bit index into the scene material table (MATERIAL_NONE when empty)
+        normal      world space normal, octahedral encoded as two 16-bit snorms
+        u, v        texture coordinates as half floats
+    World space positions are not stored, they are reconstructed from the depth buffer
+    with the inverse view-projection matrix.
+*/
+
+/**
+ * @brief 将单精度浮点数转换为半精度浮点数（就近舍入）。
+ */
+inline uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    uint32_t abs_bits = bits & 0x7FFFFFFF;
+    if (abs_bits > 0x7F800000) {
+        return sign | 0x7E00; // NaN
+    }
+    int exponent = static_cast<int>(abs_bits >> 23) - 127 + 15;
+    uint32_t mantissa = abs_bits & 0x7FFFFF;
+    if (exponent >= 31) {
+        return sign | 0x7C00; // Overflow to infinity
+    }
+    if (exponent <= 0) {
+        // Subnormal half
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint16_t half = static_cast<uint16_t>(mantissa >> shift);
+        if ((mantissa >> (shift - 1)) & 1) {
+            half++;
+        }
+        return sign | half;
+    }
+    // A carry out of the mantissa correctly bumps the exponent
+    uint16_t half = static_cast<uint16_t>(sign | (exponent << 10) | (mantissa >> 13));
+    if (mantissa & 0x1000) {
+        half++;
+    }
+    return half;
+}
+
+/**
+ * @brief 将半精度浮点数转换为单精度浮点数。
+ */
+inline float halfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F, mantissa = half & 0x3FF;
+    if (exponent == 0) {
+        float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    }
+    uint32_t bits = (exponent == 31)
+        ? sign | 0x7F800000 | (mantissa << 13)
+        : sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief 将法线编码为八面体映射下的两个 16 位 snorm，打包进一个 uint32。
+ * @param normal 法线，无需归一化；零向量编码为 +z。
+ */
+inline uint32_t encodeOctahedral(const Vec3f& normal) {
+    float l1 = std::abs(normal.x()) + std::abs(normal.y()) + std::abs(normal.z());
+    if (l1 == 0) {
+        return 0;
+    }
+    float x = normal.x() / l1, y = normal.y() / l1;
+    if (normal.z() < 0) {
+        // Fold the lower hemisphere over the diagonals
+        float fx = (1 - std::abs(y)) * (x >= 0 ? 1 : -1),
+            fy = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+        x = fx, y = fy;
+    }
+    auto quantize = [](float v) {
+        return static_cast<uint16_t>(static_cast<int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767)));
+    };
+    return static_cast<uint32_t>(quantize(x)) | (static_cast<uint32_t>(quantize(y)) << 16);
+}
+
+/**
+ * @brief 解码 encodeOctahedral 得到的法线。
+ * @return 单位长度的法线。
+ */
+inline Vec3f decodeOctahedral(uint32_t encoded) {
+    float x = static_cast<int16_t>(encoded & 0xFFFF) / 32767.0f,
+        y = static_cast<int16_t>(encoded >> 16) / 32767.0f;
+    float z = 1 - std::abs(x) - std::abs(y);
+    float t = std::max(-z, 0.0f);
+    x += (x >= 0) ? -t : t;
+    y += (y >= 0) ? -t : t;
+    return Vec3f(x, y, z).normalized();
+}
+
+/**
+ * @brief 由像素的 NDC 坐标与存储深度重建世界坐标。
+ * @param inv_view_projection (projection * view) 的逆矩阵。
+ * @param ndc_x, ndc_y 像素的 NDC 坐标。
+ * @param depth 深度缓冲区中存储的深度 |(z - 1) / 2|。
+ */
+inline Vec3f reconstructPosition(const Mat4f& inv_view_projection, float ndc_x, float ndc_y, float depth) {
+    Vec4f pos = inv_view_projection * Vec4f(ndc_x, ndc_y, 1 - 2 * depth, 1);
+    return pos.head<3>() / pos.w();
+}
+
+class GBuffer {
+public:
+    /**
+     * @brief 按分辨率分配并清空 G-Buffer。
+     */
+    void resize(int width, int height);
+
+    /**
+     * @brief 写入一个片元的属性。
+     * @param idx 像素下标 y * width + x。
+     */
+    void write(int idx, uint16_t material_id, const Vec3f& world_normal, const Vec2f& uv) {
+        material[idx] = material_id;
+        normal[idx] = encodeOctahedral(world_normal);
+        u[idx] = floatToHalf(uv.x());
+        v[idx] = floatToHalf(uv.y());
+    }
+
+    Vec3f normalAt(int idx) const { return decodeOctahedral(normal[idx]); }
+    Vec2f uvAt(int idx) const { return Vec2f(halfToFloat(u[idx]), halfToFloat(v[idx])); }
+
+    /* SoA Channels */
+    std::vector<uint16_t> material;
+    std::vector<uint32_t> normal;
+    std::vector<uint16_t> u, v;
+};
+
+#endif // GBUFFER_HPP_
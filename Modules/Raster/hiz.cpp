@@ -0,0 +1,40 @@
+#include "hiz.hpp"
+
+void HiZBuffer::reset(int width, int height, float depth) {
+    this->width = width;
+    this->height = height;
+    cells_x = (width + RASTER_HIZ_CELL - 1) / RASTER_HIZ_CELL;
+    cells_y = (height + RASTER_HIZ_CELL - 1) / RASTER_HIZ_CELL;
+    max_depth.assign(cells_x * cells_y, depth);
+    dirty.assign(cells_x * cells_y, 0);
+}
+
+float HiZBuffer::regionMax(int min_x, int min_y, int max_x, int max_y) const {
+    float region_max = 0;
+    for (int cy = min_y / RASTER_HIZ_CELL; cy <= (max_y - 1) / RASTER_HIZ_CELL; cy++) {
+        for (int cx = min_x / RASTER_HIZ_CELL; cx <= (max_x - 1) / RASTER_HIZ_CELL; cx++) {
+            region_max = std::max(region_max, max_depth[cy * cells_x + cx]);
+        }
+    }
+    return region_max;
+}
+
+void HiZBuffer::refresh(const std::vector<float>& depth_buffer, int min_x, int min_y, int max_x, int max_y) {
+    for (int cy = min_y / RASTER_HIZ_CELL; cy <= (max_y - 1) / RASTER_HIZ_CELL; cy++) {
+        for (int cx = min_x / RASTER_HIZ_CELL; cx <= (max_x - 1) / RASTER_HIZ_CELL; cx++) {
+            if (!dirty[cy * cells_x + cx]) {
+                continue;
+            }
+            int x_end = std::min((cx + 1) * RASTER_HIZ_CELL, width),
+                y_end = std::min((cy + 1) * RASTER_HIZ_CELL, height);
+            float cell_max = 0;
+            for (int y = cy * RASTER_HIZ_CELL; y < y_end; y++) {
+                for (int x = cx * RASTER_HIZ_CELL; x < x_end; x++) {
+                    cell_max = std::max(cell_max, depth_buffer[y * width + x]);
+                }
+            }
+            max_depth[cy * cells_x + cx] = cell_max;
+            dirty[cy * cells_x + cx] = 0;
+        }
+    }
+}
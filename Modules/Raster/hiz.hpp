@@ -0,0 +1,45 @@
+#ifndef HIZ_HPP_
+#define HIZ_HPP_
+
+#include "utils.hpp"
+#include <cstdint>
+
+/*
+Hierarchical Z Buffer
+    Keeps the maximum stored depth of every RASTER_HIZ_CELL x RASTER_HIZ_CELL cell of a
+    depth buffer. A triangle whose nearest depth is not closer than a cell's maximum cannot
+    pass the depth test anywhere in that cell, so the cell is skipped before any per-pixel work.
+    The maximum is only ever too large (conservative): cells that received new depths are
+    marked dirty and recomputed by refresh().
+*/
+class HiZBuffer {
+public:
+    /**
+     * @brief 按深度缓冲区的分辨率分配并清空 HiZ。
+     * @param width, height 深度缓冲区的分辨率。
+     * @param depth 初始的最大深度，应与深度缓冲区的清除值一致。
+     */
+    void reset(int width, int height, float depth = 1);
+
+    /**
+     * @brief 像素矩形 [min_x, max_x) x [min_y, max_y) 所覆盖的单元中的最大深度。
+     */
+    float regionMax(int min_x, int min_y, int max_x, int max_y) const;
+
+    /**
+     * @brief 用深度缓冲区重新计算像素矩形内所有脏单元的最大深度。
+     * @param depth_buffer 深度缓冲区，一行的像素数与 reset 时的宽度相同。
+     */
+    void refresh(const std::vector<float>& depth_buffer, int min_x, int min_y, int max_x, int max_y);
+
+    float cellMax(int cx, int cy) const { return max_depth[cy * cells_x + cx]; }
+    void markDirty(int cx, int cy) { dirty[cy * cells_x + cx] = 1; }
+
+private:
+    int width = 0, height = 0;
+    int cells_x = 0, cells_y = 0;
+    std::vector<float> max_depth;
+    std::vector<uint8_t> dirty;
+};
+
+#endif // HIZ_HPP_
@@ -0,0 +1,87 @@
+#ifndef RASTERCORE_HPP_
+#define RASTERCORE_HPP_
+
+#include "rasterkernel.hpp"
+#include "clipper.hpp"
+#include "gbuffer.hpp"
+
+/*
+Raster Core
+    The primitive and fragment stages shared by every raster pass: the camera pass and the
+    shadow maps clip, triangulate and rasterize through the same code, and only differ in the
+    attribute policy they instantiate the raster kernel with. A policy is the fragment functor
+    fragment(x, y, weights, depth) and interpolates the attributes of the three corners of the
+    rasterized triangle, so the variant is resolved at compile time:
+        DepthOnlyAttributes     depth only (shadow maps), no fragment is handed over at all
+        DepthIdAttributes       depth and the triangle index (visibility buffer)
+        GBufferAttributes       depth, material, normal and uv (compact G-Buffer)
+*/
+
+/**
+ * @brief 仅写深度，光栅化内核不会为其交出任何片元。
+ */
+struct DepthOnlyAttributes {
+    void operator()(int, int, const Vec3f&, float) const {}
+};
+
+template <>
+struct RasterFragmentTraits<DepthOnlyAttributes> {
+    static constexpr bool writes_fragments = false;
+};
+
+/**
+ * @brief 深度与三角形编号，写入可见性缓冲区。
+ */
+struct DepthIdAttributes {
+    uint32_t* id_buffer;
+    int stride;
+    uint32_t id;
+
+    void operator()(int x, int y, const Vec3f&, float) const {
+        id_buffer[y * stride + x] = id;
+    }
+};
+
+/**
+ * @brief 深度与 G-Buffer 属性，插值三个角点的世界坐标法线与纹理坐标。
+ */
+struct GBufferAttributes {
+    GBuffer* g_buffer;
+    int stride;
+    uint16_t material_id;
+    Vec3f normals[3];
+    Vec2f uvs[3];
+
+    void operator()(int x, int y, const Vec3f& weights, float) const {
+        g_buffer->write(
+            y * stride + x, material_id,
+            weights.x() * normals[0] + weights.y() * normals[1] + weights.z() * normals[2],
+            weights.x() * uvs[0] + weights.y() * uvs[1] + weights.z() * uvs[2]
+        );
+    }
+};
+
+/**
+ * @brief 图元阶段：裁剪一个三角形，并将裁剪后的多边形按 (0, k, k + 1) 三角化。
+ * @param clipper 按目标缓冲区分辨率构造的裁剪器。
+ * @param clip 三个顶点的裁剪空间坐标。
+ * @param triangle 每个扇形三角形调用一次 triangle(corners, ndc)，corners 为三个角点的裁剪顶点，
+ *                 其权重是相对输入三角形的重心坐标，ndc 为透视除法后的坐标。
+ * @return 裁剪后多边形的顶点数，三角形被剔除时返回 0。
+ */
+template <typename TriangleFunc>
+inline int clipTriangle(const TriangleClipper& clipper, const Vec4f clip[3], TriangleFunc&& triangle) {
+    ClipVertex polygon[RASTER_MAX_CLIP_VERTICES];
+    int vertex_cnt = clipper.clip(clip, polygon);
+    for (int k = 1; k + 1 < vertex_cnt; k++) {
+        const ClipVertex* corners[3] = {&polygon[0], &polygon[k], &polygon[k + 1]};
+        Vec3f ndc[3];
+        for (int i = 0; i < 3; i++) {
+            ndc[i] = corners[i]->position.head<3>() / corners[i]->position.w();
+        }
+        triangle(corners, ndc);
+    }
+    return vertex_cnt;
+}
+
+#endif // RASTERCORE_HPP_
@@ -0,0 +1,13 @@
+#include "rasterkernel.hpp"
+#include <cstdlib>
+
+bool rasterUseAVX2() {
+#ifdef RASTER_KERNEL_AVX2
+    static const bool use_avx2 =
+        __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+        std::getenv("HYPOX_RASTER_SCALAR") == nullptr;
+    return use_avx2;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,305 @@
+#ifndef RASTERKERNEL_HPP_
+#define RASTERKERNEL_HPP_
+
+#include "trianglesetup.hpp"
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RASTER_KERNEL_AVX2
+#include <immintrin.h>
+#endif
+
+/*
+Raster Kernel
+    Walks the pixels of a set-up triangle, evaluates coverage, barycentrics and depth,
+    runs the depth test and writes the depth buffer. Surviving fragments are handed to
+    fragment(x, y, weights, depth), which writes whatever attributes the caller needs.
+    Depth is stored as |(z - 1) / 2|, smaller is closer.
+
+    The AVX2 kernel walks 8x8 pixel blocks aligned to 8 pixels: blocks outside an edge are
+    skipped and blocks inside all edges skip the coverage test, the rows of a block are 8x1
+    SIMD steps. It is chosen at runtime when the CPU supports it, otherwise the scalar kernel
+    is used.
+
+    RasterFragmentTraits tells the kernels at compile time whether a fragment functor writes
+    anything; for depth-only functors the per-fragment hand-off is compiled out (see rastercore.hpp).
+*/
+
+/**
+ * @brief 片元回调的编译期属性，默认每个通过深度测试的片元都交给回调。
+ */
+template <typename FragmentFunc>
+struct RasterFragmentTraits {
+    static constexpr bool writes_fragments = true;
+};
+
+/**
+ * @brief 运行时检测是否使用 AVX2 光栅化内核。
+ * @return CPU 支持 AVX2 与 FMA 且未设置环境变量 HYPOX_RASTER_SCALAR 时返回 true。
+ */
+bool rasterUseAVX2();
+
+/**
+ * @brief 标量光栅化内核。
+ * @param tri 已完成 setup 的三角形。
+ * @param min_x, min_y, max_x, max_y 遍历范围（左闭右开），调用者应先与 tri 的包围盒求交。
+ * @param depth_buffer 深度缓冲区，stride 为一行的像素数。
+ * @param depth_min 小于该值的深度直接丢弃。
+ * @param fragment 每个通过深度测试的片元调用一次 fragment(x, y, weights, depth)。
+ * @return 被三角形覆盖的像素数（深度测试之前）。
+ */
+template <typename FragmentFunc>
+inline int rasterizeTriangleScalar(
+    const TriangleSetup& tri, int min_x, int min_y, int max_x, int max_y,
+    float* depth_buffer, int stride, float depth_min, FragmentFunc&& fragment
+) {
+    int covered = 0;
+    for (int y = min_y; y < max_y; y++) {
+        int64_t e0 = tri.A[0] * min_x + tri.B[0] * y + tri.C[0],
+                e1 = tri.A[1] * min_x + tri.B[1] * y + tri.C[1],
+                e2 = tri.A[2] * min_x + tri.B[2] * y + tri.C[2];
+        for (int x = min_x; x < max_x; x++, e0 += tri.A[0], e1 += tri.A[1], e2 += tri.A[2]) {
+            // All three edge values are non-negative <=> the sign bit of their OR is clear
+            if ((e0 | e1 | e2) < 0) {
+                continue;
+            }
+            covered++;
+            Vec3f weights(
+                static_cast<float>(e0) * tri.inv_area,
+                static_cast<float>(e1) * tri.inv_area,
+                static_cast<float>(e2) * tri.inv_area
+            );
+            float depth = std::abs(
+                (weights.x() * tri.z[0] + weights.y() * tri.z[1] + weights.z() * tri.z[2] - 1) / 2
+            );
+            float& buffer = depth_buffer[y * stride + x];
+            if (!(depth < buffer && depth >= depth_min)) {
+                continue;
+            }
+            buffer = depth;
+            if constexpr (RasterFragmentTraits<std::decay_t<FragmentFunc>>::writes_fragments) {
+                fragment(x, y, weights, depth);
+            }
+        }
+    }
+    return covered;
+}
+
+#ifdef RASTER_KERNEL_AVX2
+/**
+ * @brief 起点为 x0 的 8x1 像素块中落在 [min_x, max_x) 内的通道掩码。
+ */
+__attribute__((target("avx2"))) inline __m256i rangeMaskAVX2(int x0, int min_x, int max_x) {
+    __m256i xs = _mm256_add_epi32(_mm256_set1_epi32(x0), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    return _mm256_and_si256(
+        _mm256_cmpgt_epi32(xs, _mm256_set1_epi32(min_x - 1)), _mm256_cmpgt_epi32(_mm256_set1_epi32(max_x), xs)
+    );
+}
+
+/**
+ * @brief AVX2 内核的深度测试：对一个 8x1 像素块做深度测试并写入通过的深度。
+ * @param cover 覆盖掩码，depth 为 8 个通道的存储深度，depth_row 指向该行深度缓冲区。
+ * @param in_range 8 个通道是否都在遍历范围内，此时直接整块读写，否则使用掩码读写。
+ * @return 通过深度测试的通道掩码。
+ */
+__attribute__((target("avx2"))) inline int depthTestAVX2(
+    __m256 cover, __m256 depth, float* depth_row, int x0, bool in_range, float depth_min
+) {
+    __m256 buffer = in_range
+        ? _mm256_loadu_ps(depth_row + x0) : _mm256_maskload_ps(depth_row + x0, _mm256_castps_si256(cover));
+    __m256 pass = _mm256_and_ps(cover, _mm256_and_ps(
+        _mm256_cmp_ps(depth, buffer, _CMP_LT_OQ), _mm256_cmp_ps(depth, _mm256_set1_ps(depth_min), _CMP_GE_OQ)
+    ));
+    int pass_mask = _mm256_movemask_ps(pass);
+    if (pass_mask == 0) {
+        return 0;
+    }
+    if (in_range) {
+        _mm256_storeu_ps(depth_row + x0, _mm256_blendv_ps(buffer, depth, pass));
+    } else {
+        _mm256_maskstore_ps(depth_row + x0, _mm256_castps_si256(pass), depth);
+    }
+    return pass_mask;
+}
+
+/**
+ * @brief 将一个 8x1 像素块中通过深度测试的片元逐个交给回调。
+ * @param w 三个重心坐标分量，depth 为存储深度。
+ */
+template <typename FragmentFunc>
+__attribute__((target("avx2"))) inline void emitFragmentsAVX2(
+    int pass_mask, const __m256 w[3], __m256 depth, int x0, int y, FragmentFunc&& fragment
+) {
+    alignas(32) float weights_out[3][8], depth_out[8];
+    _mm256_store_ps(weights_out[0], w[0]);
+    _mm256_store_ps(weights_out[1], w[1]);
+    _mm256_store_ps(weights_out[2], w[2]);
+    _mm256_store_ps(depth_out, depth);
+    while (pass_mask) {
+        int k = __builtin_ctz(pass_mask);
+        fragment(x0 + k, y, Vec3f(weights_out[0][k], weights_out[1][k], weights_out[2][k]), depth_out[k]);
+        pass_mask &= pass_mask - 1;
+    }
+}
+
+/**
+ * @brief AVX2 光栅化内核，参数与返回值同 rasterizeTriangleScalar。
+ * @note 遍历范围按 8 像素对齐划分为 8x8 像素块，每块先用四个角点的 int64 边方程值分类：
+ *       某条边在四个角点都为负则整块跳过；三条边都非负则整块覆盖，块内不再做覆盖测试；
+ *       否则只测试穿过该块的边，这些边在块内的取值不超过 7 (|A_i| + |B_i|)，可直接用 int32 表示。
+ *       块内每行是一个 8x1 像素块，边方程值与存储深度都按行增量步进，深度取自块起点处的平面方程。
+ *       要求 |A_i|, |B_i| < 2^27，即三角形跨度小于 2048 像素，否则退回标量内核。
+ */
+template <typename FragmentFunc>
+__attribute__((target("avx2,fma"))) inline int rasterizeTriangleAVX2(
+    const TriangleSetup& tri, int min_x, int min_y, int max_x, int max_y,
+    float* depth_buffer, int stride, float depth_min, FragmentFunc&& fragment
+) {
+    constexpr bool writes_fragments = RasterFragmentTraits<std::decay_t<FragmentFunc>>::writes_fragments;
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i minus_one = _mm256_set1_epi32(-1);
+    const __m256 lane_f = _mm256_cvtepi32_ps(lane);
+    const __m256 inv_area = _mm256_set1_ps(tri.inv_area);
+    const int x_begin = min_x & ~7, y_begin = min_y & ~7;
+
+    __m256i edge_lane[3], edge_step[3];
+    __m256 weight_lane[3];
+    for (int i = 0; i < 3; i++) {
+        edge_lane[i] = _mm256_mullo_epi32(lane, _mm256_set1_epi32(static_cast<int32_t>(tri.A[i])));
+        edge_step[i] = _mm256_set1_epi32(static_cast<int32_t>(tri.B[i]));
+        weight_lane[i] = _mm256_mul_ps(lane_f, _mm256_set1_ps(static_cast<float>(tri.A[i]) * tri.inv_area));
+    }
+
+    // Stored depth (z - 1) / 2 = depth_0 + depth_dx * (x - x_begin) + depth_dy * (y - y_begin)
+    double depth_0 = 0, depth_dx = 0, depth_dy = 0;
+    for (int i = 0; i < 3; i++) {
+        depth_0 += static_cast<double>(tri.A[i] * x_begin + tri.B[i] * y_begin + tri.C[i]) * tri.z[i];
+        depth_dx += static_cast<double>(tri.A[i]) * tri.z[i];
+        depth_dy += static_cast<double>(tri.B[i]) * tri.z[i];
+    }
+    depth_0 = (depth_0 * tri.inv_area - 1) / 2;
+    depth_dx = depth_dx * tri.inv_area / 2;
+    depth_dy = depth_dy * tri.inv_area / 2;
+    const __m256 depth_lane = _mm256_mul_ps(lane_f, _mm256_set1_ps(static_cast<float>(depth_dx)));
+    const __m256 depth_step = _mm256_set1_ps(static_cast<float>(depth_dy));
+    const __m256 sign_bit = _mm256_set1_ps(-0.0f);
+
+    int covered = 0;
+    for (int y0 = y_begin; y0 < max_y; y0 += 8) {
+        const int row_begin = std::max(y0, min_y), row_end = std::min(y0 + 8, max_y);
+        // Edge values at the first block of the row, and their extremes over a block
+        int64_t e[3], lo_offset[3], hi_offset[3];
+        for (int i = 0; i < 3; i++) {
+            int64_t dx = 7 * tri.A[i], dy = (row_end - 1 - row_begin) * tri.B[i];
+            e[i] = tri.A[i] * x_begin + tri.B[i] * row_begin + tri.C[i];
+            lo_offset[i] = std::min<int64_t>(dx, 0) + std::min<int64_t>(dy, 0);
+            hi_offset[i] = std::max<int64_t>(dx, 0) + std::max<int64_t>(dy, 0);
+        }
+        for (int x0 = x_begin; x0 < max_x; x0 += 8, e[0] += 8 * tri.A[0], e[1] += 8 * tri.A[1], e[2] += 8 * tri.A[2]) {
+            // 1. Classify the block by the edge values at its four corners
+            int partial_edges = 0, outside_edges = 0;
+            bool fits_int32 = true;
+            for (int i = 0; i < 3; i++) {
+                int64_t lo = e[i] + lo_offset[i], hi = e[i] + hi_offset[i];
+                outside_edges |= (hi < 0) << i;
+                partial_edges |= (lo < 0) << i;
+                fits_int32 = fits_int32 && lo > INT32_MIN && hi < INT32_MAX;
+            }
+            if (outside_edges) {
+                // Edges that do not grow along x stay outside for the rest of the row
+                bool leaving = false;
+                for (int i = 0; i < 3; i++) {
+                    leaving = leaving || ((outside_edges >> i & 1) && tri.A[i] <= 0);
+                }
+                if (leaving) {
+                    break;
+                }
+                continue;
+            }
+
+            // 2. Step the rows of the block, only the edges crossing it are tested
+            const bool in_range = x0 >= min_x && x0 + 8 <= max_x;
+            const __m256i range = in_range ? minus_one : rangeMaskAVX2(x0, min_x, max_x);
+            // Edges that neither cross the block nor fit into int32 are stepped but never read
+            __m256i edge[3];
+            for (int i = 0; i < 3; i++) {
+                edge[i] = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int32_t>(e[i])), edge_lane[i]);
+            }
+            __m256 depth = _mm256_add_ps(depth_lane, _mm256_set1_ps(static_cast<float>(
+                depth_0 + depth_dx * (x0 - x_begin) + depth_dy * (row_begin - y_begin)
+            )));
+            const int range_mask = _mm256_movemask_ps(_mm256_castsi256_ps(range));
+            float* depth_row = depth_buffer + row_begin * stride;
+            for (int y = row_begin; y < row_end; y++, depth_row += stride) {
+                __m256i cover = range;
+                int cover_mask = range_mask;
+                if (partial_edges) {
+                    for (int i = 0; i < 3; i++) {
+                        if (partial_edges >> i & 1) {
+                            cover = _mm256_and_si256(cover, _mm256_cmpgt_epi32(edge[i], minus_one));
+                        }
+                    }
+                    cover_mask = _mm256_movemask_ps(_mm256_castsi256_ps(cover));
+                }
+                if (cover_mask) {
+                    covered += __builtin_popcount(cover_mask);
+                    __m256 stored = _mm256_andnot_ps(sign_bit, depth);
+                    int pass_mask = depthTestAVX2(
+                        _mm256_castsi256_ps(cover), stored, depth_row, x0, in_range, depth_min
+                    );
+                    if constexpr (writes_fragments) {
+                        if (pass_mask) {
+                            __m256 w[3];
+                            for (int i = 0; i < 3; i++) {
+                                w[i] = fits_int32
+                                    ? _mm256_mul_ps(_mm256_cvtepi32_ps(edge[i]), inv_area)
+                                    : _mm256_add_ps(weight_lane[i], _mm256_set1_ps(
+                                        static_cast<float>(e[i] + (y - row_begin) * tri.B[i]) * tri.inv_area
+                                    ));
+                            }
+                            emitFragmentsAVX2(pass_mask, w, stored, x0, y, fragment);
+                        }
+                    }
+                }
+                depth = _mm256_add_ps(depth, depth_step);
+                // Inside all three edges nothing but the weights reads the edges
+                if (partial_edges || writes_fragments) {
+                    for (int i = 0; i < 3; i++) {
+                        edge[i] = _mm256_add_epi32(edge[i], edge_step[i]);
+                    }
+                }
+            }
+        }
+    }
+    return covered;
+}
+#endif
+
+/**
+ * @brief 光栅化单个三角形，根据 CPU 支持情况与遍历范围大小选择 AVX2 或标量内核。
+ * @note 参数与返回值同 rasterizeTriangleScalar。
+ */
+template <typename FragmentFunc>
+inline int rasterizeTriangle(
+    const TriangleSetup& tri, int min_x, int min_y, int max_x, int max_y,
+    float* depth_buffer, int stride, float depth_min, FragmentFunc&& fragment
+) {
+#ifdef RASTER_KERNEL_AVX2
+    // Tiny rectangles are dominated by the block setup, which the scalar kernel does not pay
+    const int64_t step_limit = int64_t(1) << 27;
+    if (
+        rasterUseAVX2() && (max_x - min_x) * (max_y - min_y) >= RASTER_SIMD_MIN_AREA &&
+        std::abs(tri.A[0]) < step_limit && std::abs(tri.A[1]) < step_limit && std::abs(tri.A[2]) < step_limit &&
+        std::abs(tri.B[0]) < step_limit && std::abs(tri.B[1]) < step_limit && std::abs(tri.B[2]) < step_limit
+    ) {
+        return rasterizeTriangleAVX2(
+            tri, min_x, min_y, max_x, max_y, depth_buffer, stride, depth_min, fragment
+        );
+    }
+#endif
+    return rasterizeTriangleScalar(
+        tri, min_x, min_y, max_x, max_y, depth_buffer, stride, depth_min, fragment
+    );
+}
+
+#endif // RASTERKERNEL_HPP_
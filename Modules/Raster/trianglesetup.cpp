@@ -0,0 +1,74 @@
+#include "trianglesetup.hpp"
+
+/**
+ * @brief 将 NDC 坐标转换为定点数表示的屏幕坐标。
+ * @param ndc NDC 坐标。
+ * @param size 对应方向的分辨率。
+ * @param fixed 输出的定点坐标，含 RASTER_SUBPIXEL_BITS 位小数。
+ * @return 坐标超出定点表示范围（或为 NaN）时返回 false。
+ */
+static inline bool toFixed(float ndc, int size, int64_t& fixed) {
+    float screen = (ndc + 1) / 2 * static_cast<float>(size);
+    if (!(std::abs(screen) < RASTER_FIXED_RANGE)) {
+        return false;
+    }
+    fixed = static_cast<int64_t>(std::llround(screen * (1 << RASTER_SUBPIXEL_BITS)));
+    return true;
+}
+
+bool TriangleSetup::setup(const Vec3f& p0, const Vec3f& p1, const Vec3f& p2, int width, int height) {
+    const Vec3f* p[3] = {&p0, &p1, &p2};
+    int64_t fx[3], fy[3];
+    for (int i = 0; i < 3; i++) {
+        if (!toFixed(p[i]->x(), width, fx[i]) || !toFixed(p[i]->y(), height, fy[i])) {
+            return false;
+        }
+        z[i] = p[i]->z();
+    }
+    // Stored depth is linear in z only while z <= 1, otherwise fall back to the closest value
+    float max_z = std::max(z[0], std::max(z[1], z[2]));
+    min_depth = (max_z <= 1) ? (1 - max_z) / 2 : 0;
+
+    // Bounding Box: pixel x covers the sample x << RASTER_SUBPIXEL_BITS
+    int64_t min_fx = std::min(fx[0], std::min(fx[1], fx[2])), max_fx = std::max(fx[0], std::max(fx[1], fx[2])),
+            min_fy = std::min(fy[0], std::min(fy[1], fy[2])), max_fy = std::max(fy[0], std::max(fy[1], fy[2]));
+    const int64_t one = 1 << RASTER_SUBPIXEL_BITS;
+    min_x = static_cast<int>(std::max<int64_t>((min_fx + one - 1) >> RASTER_SUBPIXEL_BITS, 0));
+    min_y = static_cast<int>(std::max<int64_t>((min_fy + one - 1) >> RASTER_SUBPIXEL_BITS, 0));
+    max_x = static_cast<int>(std::min<int64_t>((max_fx >> RASTER_SUBPIXEL_BITS) + 1, width));
+    max_y = static_cast<int>(std::min<int64_t>((max_fy >> RASTER_SUBPIXEL_BITS) + 1, height));
+    if (min_x >= max_x || min_y >= max_y) {
+        return false;
+    }
+
+    // Edge Equations
+    for (int i = 0; i < 3; i++) {
+        int a = (i + 1) % 3, b = (i + 2) % 3;
+        int64_t dx = fx[b] - fx[a], dy = fy[b] - fy[a];
+        A[i] = -dy * one;
+        B[i] = dx * one;
+        C[i] = dy * fx[a] - dx * fy[a];
+    }
+    // Twice the signed area, make the inside positive for both windings
+    int64_t area = (fx[2] - fx[1]) * (fy[0] - fy[1]) - (fy[2] - fy[1]) * (fx[0] - fx[1]);
+    if (area == 0) {
+        return false;
+    }
+    if (area < 0) {
+        for (int i = 0; i < 3; i++) {
+            A[i] = -A[i], B[i] = -B[i], C[i] = -C[i];
+        }
+        area = -area;
+    }
+    inv_area = 1.0f / static_cast<float>(area);
+
+    // Top-Left Fill Rule: a shared edge belongs to exactly one of its two triangles,
+    // pixels lying exactly on the other edges are rejected by biasing them by one unit.
+    for (int i = 0; i < 3; i++) {
+        bool top_left = (A[i] > 0) || (A[i] == 0 && B[i] < 0);
+        if (!top_left) {
+            C[i] -= 1;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,45 @@
+#ifndef TRIANGLESETUP_HPP_
+#define TRIANGLESETUP_HPP_
+
+#include "utils.hpp"
+#include <cstdint>
+
+/*
+Triangle Setup
+    Everything a triangle needs for rasterization is computed once here:
+    the edge equations in fixed point, the reciprocal area and the pixel bounding box.
+    Pixel (x, y) samples the screen at NDC (2x / width - 1, 2y / height - 1).
+*/
+class TriangleSetup {
+public:
+    /**
+     * @brief 根据屏幕空间（NDC）中的三个顶点建立三角形。
+     * @param p0, p1, p2 NDC 坐标下的三个顶点，z 为深度。
+     * @param width, height 目标缓冲区的分辨率。
+     * @return 三角形可以光栅化时返回 true；退化、完全在屏幕外或超出定点范围时返回 false。
+     * @note 两种绕序都会被接受，边方程统一为三角形内部取正值。
+     */
+    bool setup(const Vec3f& p0, const Vec3f& p1, const Vec3f& p2, int width, int height);
+
+    /**
+     * @brief 计算像素 (x, y) 处的重心坐标，与光栅化内核得到的 weights 一致。
+     */
+    Vec3f weightsAt(int x, int y) const {
+        return Vec3f(
+            static_cast<float>(A[0] * x + B[0] * y + C[0]) * inv_area,
+            static_cast<float>(A[1] * x + B[1] * y + C[1]) * inv_area,
+            static_cast<float>(A[2] * x + B[2] * y + C[2]) * inv_area
+        );
+    }
+
+    /* Edge Equations: E_i(x, y) = A_i * x + B_i * y + C_i, edge i is opposite to vertex i */
+    int64_t A[3], B[3], C[3];
+    /* Interpolation */
+    float inv_area; // 1 / (E_0 + E_1 + E_2)
+    float z[3];
+    float min_depth; // nearest stored depth |(z - 1) / 2| over the triangle
+    /* Pixel Bounding Box, [min, max) */
+    int min_x, min_y, max_x, max_y;
+};
+
+#endif // TRIANGLESETUP_HPP_
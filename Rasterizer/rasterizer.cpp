@@ -1,6 +1,13 @@
 #include "rasterizer.hpp"
 #include "shadowmap.hpp"
+#include "denoise.hpp"
+#include "assetcache.hpp"
 #include <map>
+#include <algorithm>
+#include <omp.h>
+#include <chrono>
+#include <exception>
+#include <filesystem>
 
 /**
  * @brief 构造函数，从配置文件初始化光栅化器。
@@ -12,24 +19,116 @@ Rasterizer::Rasterizer(const std::string& config_path) {
     printf("%s\n", config_path.c_str());
     Config config(config_path);
     initializeFromConfig(config);
-    // Initialize Buffers.
-    triangle_buffer.clear();
+    initializeBuffers();
+}
+
+/**
+ * @brief 按相机分辨率与流水线类型分配屏幕空间缓冲区。
+ * @note 前向流水线使用紧凑的 G-Buffer，可见性缓冲流水线只保存三角形下标。
+ */
+void Rasterizer::initializeBuffers() {
+    uint32_t resolution = camera->getWidth() * camera->getHeight();
+    frame_triangles.clear();
+    clipped_corners.clear();
 
     // Initialize the Screen Space Buffer with -
-    color_buffer.resize(camera->getWidth() * camera->getHeight(), Vec3f::Zero());
-    depth_buffer.resize(camera->getWidth() * camera->getHeight(), 1);
-    position_buffer.resize(camera->getWidth() * camera->getHeight(), Vec3f::Zero());
-    normal_buffer.resize(camera->getWidth() * camera->getHeight(), Vec3f::Zero());
-    org_position_buffer.resize(camera->getWidth() * camera->getHeight(), Vec3f::Zero());
-    org_normal_buffer.resize(camera->getWidth() * camera->getHeight(), Vec3f::Zero());
-    uv_buffer.resize(camera->getWidth() * camera->getHeight(), -Vec2f::Ones());
-    material_buffer.resize(camera->getWidth() * camera->getHeight(), nullptr);
+    color_buffer.resize(resolution, Vec3f::Zero());
+    depth_buffer.resize(resolution, 1);
+    if (pipeline == Visibility_Pipeline) {
+        visibility_buffer.resize(resolution, RASTER_INVALID_ID);
+    }
+    else {
+        g_buffer.resize(camera->getWidth(), camera->getHeight());
+    }
+}
+
+/**
+ * @brief 清空上一帧的三角形缓冲区与屏幕空间缓冲区，保留已分配的内存。
+ * @note 场景、材质与阴影贴图不受影响。G-Buffer 只在深度小于 1 的像素上被读取，无需清空。
+ */
+void Rasterizer::clearFrame() {
+    frame_triangles.clear();
+    clipped_corners.clear();
+    triangle_material_ids.clear();
+    std::fill(color_buffer.begin(), color_buffer.end(), Vec3f::Zero());
+    std::fill(depth_buffer.begin(), depth_buffer.end(), 1.0f);
+    std::fill(visibility_buffer.begin(), visibility_buffer.end(), RASTER_INVALID_ID);
+}
+
+/**
+ * @brief 资源文件的大小，用于安排并行加载的顺序。
+ * @return 文件不存在时返回 0，错误留给加载时报告。
+ */
+static uintmax_t assetSize(const std::string& file_name) {
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(file_name, error);
+    return error ? 0 : size;
+}
+
+/**
+ * @brief 描述决定间接光的场景内容，其哈希值是探针网格缓存的键。
+ * @note 包括对象的路径、网格内容哈希、变换与材质，光源的参数，间接光采样数与阴影贴图分辨率；
+ *       相机不影响探针网格，不计入其中。只依赖配置与源文件，不需要先生成反射阴影贴图。
+ */
+static std::string describeIndirectScene(const Config& config, AssetCache& assets) {
+    std::string scene;
+    auto append = [&scene](const void* data, size_t size) {
+        scene.append(static_cast<const char*>(data), size);
+    };
+    auto append_string = [&append](const std::string& text) {
+        uint64_t length = text.size();
+        append(&length, sizeof(length));
+        append(text.data(), text.size());
+    };
+    // 1. Sampling of the reflective shadow maps
+    append(&config.render_config.indirect_samples, sizeof(int));
+    append(&config.render_config.soft_shadows, sizeof(bool));
+    // 2. Objects with their meshes, transforms and the materials that give the albedo of the VPLs
+    std::map<std::string, const MaterialConfig*> materials;
+    for (const MaterialConfig& mat_config : config.materials_config) {
+        materials[mat_config.name] = &mat_config;
+    }
+    for (const ObjectConfig& obj_config : config.objects_config) {
+        uint64_t mesh_key = assets.getMeshKey(obj_config.file_path);
+        append_string(obj_config.file_path);
+        append(&mesh_key, sizeof(mesh_key));
+        append(obj_config.translation.data(), sizeof(float) * 3);
+        append(obj_config.rotation.data(), sizeof(float) * 3);
+        append(obj_config.scale.data(), sizeof(float) * 3);
+        auto found = materials.find(obj_config.material);
+        if (found == materials.end()) {
+            continue;
+        }
+        const MaterialConfig& mat_config = *found->second;
+        append(&mat_config.type, sizeof(mat_config.type));
+        append(&mat_config.shininess, sizeof(float));
+        if (mat_config.type == Color_Mat) {
+            append(mat_config.base_color.data(), sizeof(float) * 3);
+        }
+        else {
+            uint64_t texture_key = assets.getTextureKey(mat_config.texture_file_path);
+            append(&texture_key, sizeof(texture_key));
+        }
+    }
+    // 3. Lights
+    for (const LightConfig& light_config : config.lights_config) {
+        append(&light_config.type, sizeof(light_config.type));
+        append(light_config.position.data(), sizeof(float) * 3);
+        append(light_config.intensity.data(), sizeof(float) * 3);
+        if (light_config.type == Area_Light) {
+            append(light_config.normal.data(), sizeof(float) * 3);
+            append(light_config.size.data(), sizeof(float) * 2);
+        }
+    }
+    return scene;
 }
 
 /**
  * @brief 根据配置文件初始化光栅化器。
  * @param config 配置对象。
  * @note 初始化相机、场景中的对象和光源，并为光源生成阴影贴图。
+ *       纹理与网格由 OpenMP 线程并行加载，全部完成后才生成阴影贴图。
+ *       相同内容的文件只加载一次，对象是共享网格的实例。
  */
 void Rasterizer::initializeFromConfig(const Config& config) {
     // 1. Initialize Camera
@@ -41,9 +140,54 @@ void Rasterizer::initializeFromConfig(const Config& config) {
 
     // 2. Initialize Scene
     std::shared_ptr<Scene> scn = std::make_shared<Scene>();
-    // 2.1. Initialize Materials
+    // 2.1. Load the Assets: each distinct texture and mesh file is decoded once, concurrently
+    //      The largest files are started first, so that loading takes about as long as the largest asset
+    //      Files with identical contents are shared through the content-addressed asset cache
+    AssetCache assets;
+    std::vector<std::pair<uintmax_t, std::string>> jobs; // (file size, file)
+    std::map<std::string, bool> asset_is_texture; // distinct files, true for textures and false for meshes
+    for (const MaterialConfig& mat_config : config.materials_config) {
+        if (mat_config.type == Texture_Mat && asset_is_texture.emplace(mat_config.texture_file_path, true).second) {
+            jobs.emplace_back(assetSize(mat_config.texture_file_path), mat_config.texture_file_path);
+        }
+    }
+    for (const ObjectConfig& obj_config : config.objects_config) {
+        if (asset_is_texture.emplace(obj_config.file_path, false).second) {
+            jobs.emplace_back(assetSize(obj_config.file_path), obj_config.file_path);
+        }
+    }
+    std::stable_sort(jobs.begin(), jobs.end(),
+        [](const std::pair<uintmax_t, std::string>& a, const std::pair<uintmax_t, std::string>& b) {
+            return a.first > b.first;
+        });
+    // Exceptions cannot leave a parallel region, they are rethrown once all jobs are joined
+    std::vector<std::exception_ptr> errors(jobs.size());
+    auto start_time = std::chrono::steady_clock::now();
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int j = 0; j < static_cast<int>(jobs.size()); j++) {
+        const std::string& file_name = jobs[j].second;
+        try {
+            if (asset_is_texture.at(file_name)) {
+                assets.getTexture(file_name);
+            }
+            else {
+                assets.getMesh(file_name);
+            }
+        } catch (...) {
+            errors[j] = std::current_exception();
+        }
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    printf("Loaded %ld meshes and %ld textures in %.2f ms\n",
+        static_cast<long>(assets.getMeshCount()), static_cast<long>(assets.getTextureCount()),
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count());
+    // 2.2. Initialize Materials, the textures are shared
     std::map<std::string, std::shared_ptr<Materials>> materials;
-    for (MaterialConfig mat_config : config.materials_config) {
+    for (const MaterialConfig& mat_config : config.materials_config) {
         std::shared_ptr<Materials> mat;
         if (mat_config.type == Color_Mat) {
             // Color Material: Have base_color
@@ -52,29 +196,48 @@ void Rasterizer::initializeFromConfig(const Config& config) {
             );
         } else if (mat_config.type == Texture_Mat) {
             mat = std::make_shared<TextureMaterial>(
-                mat_config.texture_file_path, mat_config.shininess
+                assets.getTexture(mat_config.texture_file_path), mat_config.shininess
             );
         }
         materials[mat_config.name] = mat;
+        scn->addMaterial(mat);
     }
     // Material for Light
     materials["light"] = std::make_shared<ColorMaterial>(
         AMBIENT.cwiseInverse()
     );
-    // 2.2. Initialize Objects
-    for (ObjectConfig obj_config : config.objects_config) {
-        std::shared_ptr<Object> obj = std::make_shared<Object>(
-            obj_config.file_path
-        );
+    scn->addMaterial(materials["light"]);
+    // 2.3. Initialize Objects: instances of the shared meshes, transformed concurrently
+    std::vector<std::shared_ptr<Object>> objects;
+    for (const ObjectConfig& obj_config : config.objects_config) {
+        objects.push_back(std::make_shared<Object>(
+            assets.getMesh(obj_config.file_path), materials[obj_config.material]
+        ));
+    }
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < static_cast<int>(objects.size()); i++) {
+        const ObjectConfig& obj_config = config.objects_config[i];
         Mat4f trans_matrix = utils::generateModelMatrix(
             obj_config.translation, obj_config.rotation, obj_config.scale
         );
-        obj->localToWorld(trans_matrix);
-        obj->setMaterial(materials[obj_config.material]);
+        objects[i]->localToWorld(trans_matrix);
+    }
+    for (const std::shared_ptr<Object>& obj : objects) {
         scn->addObject(obj);
     }
-    // 2.3. Initialize Lights
-    for (LightConfig light_config : config.lights_config) {
+    // 2.4. Look up the Irradiance Probes before the Lights: the key only depends on the scene description,
+    //      so a cached grid skips the reflective shadow maps and the indirect VPLs altogether
+    const std::string& probe_cache = config.render_config.probe_cache;
+    bool irradiance_probes = config.render_config.irradiance_probes && config.render_config.indirect_samples > 0;
+    uint64_t probe_key = 0;
+    bool probes_loaded = false;
+    if (irradiance_probes) {
+        probe_key = IrradianceProbeGrid::computeKey(describeIndirectScene(config, assets));
+        probes_loaded = !probe_cache.empty() && probe_grid.load(probe_cache, probe_key);
+    }
+    int rsm_samples = probes_loaded ? 0 : config.render_config.indirect_samples;
+    // 2.5. Initialize Lights
+    for (const LightConfig& light_config : config.lights_config) {
         std::shared_ptr<Light> light;
         if (light_config.type == Point_Light) {
             light = std::make_shared<PointLight>(
@@ -82,8 +245,7 @@ void Rasterizer::initializeFromConfig(const Config& config) {
             );
 
             // Initialize Shadow Map
-            std::vector<std::shared_ptr<Object>> objects = scn->getObjects();
-            light->initShadowMap(DEFAULT_SHADOW_MAP_RESOLUTION, objects);
+            light->initShadowMap(DEFAULT_SHADOW_MAP_RESOLUTION, scn->getObjects(), rsm_samples);
             light->showShadowMap("PointlightShadowMap.png");
         }
         else if (light_config.type == Area_Light) {
@@ -91,9 +253,12 @@ void Rasterizer::initializeFromConfig(const Config& config) {
                 light_config.position, light_config.intensity,
                 light_config.normal, light_config.size
             );
-            // Initialize Shadow Map
-            std::vector<std::shared_ptr<Object>> objects = scn->getObjects();
-            light->initShadowMap(DEFAULT_SHADOW_MAP_RESOLUTION, objects);
+            // Initialize Shadow Map, soft shadows are prefiltered from a lower resolution map
+            light->setSoftShadows(config.render_config.soft_shadows);
+            light->initShadowMap(
+                config.render_config.soft_shadows ? SOFT_SHADOW_MAP_RESOLUTION : DEFAULT_SHADOW_MAP_RESOLUTION,
+                scn->getObjects(), rsm_samples
+            );
             light->showShadowMap("ArealightShadowMap.png");
             // Add an object for the area light
             // std::shared_ptr<Object> obj = std::make_shared<Object>(
@@ -115,23 +280,107 @@ void Rasterizer::initializeFromConfig(const Config& config) {
     // 3. Initialize Rasterizer
     camera = cam;
     scene = scn;
+    pipeline = config.render_config.pipeline;
+    backface_culling = config.render_config.backface_culling;
+    light_falloff = config.render_config.light_falloff;
+    lightcuts_tolerance = config.render_config.lightcuts_tolerance;
+    vpl_samples = config.render_config.vpl_samples;
+    denoise = config.render_config.denoise;
+    indirect_samples = config.render_config.indirect_samples;
+    camera_path = config.camera_path_config;
+
+    // 4. Build the Irradiance Probes from the indirect VPLs unless they were loaded,
+    //    each of the interleaved sets covers all of the light
+    if (irradiance_probes && !probes_loaded) {
+        Vec3f min_bound = Vec3f::Constant(INFINITY), max_bound = Vec3f::Constant(-INFINITY);
+        for (const std::shared_ptr<Object>& obj : scene->getObjects()) {
+            min_bound = min_bound.cwiseMin(obj->getMinBound());
+            max_bound = max_bound.cwiseMax(obj->getMaxBound());
+        }
+        std::vector<Vec3f> positions, normals, fluxes;
+        float set_weight = 1.0f / (RSM_INTERLEAVE * RSM_INTERLEAVE);
+        for (const std::shared_ptr<Light>& light : scene->getLights()) {
+            for (const IndirectVPL& i_vpl : light->getIndirectVPLs()) {
+                positions.push_back(i_vpl.position);
+                normals.push_back(i_vpl.normal);
+                fluxes.push_back(i_vpl.flux * set_weight);
+            }
+        }
+        probe_grid.build(min_bound, max_bound, positions, normals, fluxes, probe_key);
+        if (!probe_cache.empty()) {
+            probe_grid.save(probe_cache);
+        }
+    }
+    printf("Using the %s pipeline\n", pipeline == Visibility_Pipeline ? "visibility buffer" : "forward");
 
     printf("Initialized Rasterizer with %ld objects and %ld lights\n", scene->getObjects().size(), scene->getLights().size());
 }
 
 /**
- * @brief 执行光栅化的主要流程。
- * @note 包括顶点处理、片元处理、片元着色和图像输出。
+ * @brief 渲染配置文件中的所有帧。
+ * @note 没有相机路径时渲染一帧，否则沿相机路径渲染。
  */
-void Rasterizer::Pass() {
+void Rasterizer::Render() {
+    if (camera_path.keyframes.empty()) {
+        Pass();
+    }
+    else {
+        RenderCameraPath(camera_path);
+    }
+}
+
+/**
+ * @brief 沿相机路径渲染多帧。
+ * @param path 相机路径，相邻关键帧之间线性插值相机位置与目标点。
+ * @note 各帧复用已加载的几何、纹理与阴影贴图，只重置每帧的缓冲区。
+ *       第 i 帧的图像保存为 color_000i.png 等。
+ */
+void Rasterizer::RenderCameraPath(const CameraPathConfig& path) {
+    int keyframe_cnt = path.keyframes.size();
+    if (keyframe_cnt == 0) {
+        return;
+    }
+    int frame_cnt = (path.frames > 0) ? path.frames : keyframe_cnt;
+    // A looping path ends where it starts, so the last frame stops one step before the first keyframe
+    int segment_cnt = path.loop ? keyframe_cnt : keyframe_cnt - 1;
+    int step_cnt = path.loop ? frame_cnt : frame_cnt - 1;
+
+    auto start_time = std::chrono::steady_clock::now();
+    for (int f = 0; f < frame_cnt; f++) {
+        // 1. Locate the frame on the path
+        float t = (step_cnt > 0) ? static_cast<float>(f) * segment_cnt / step_cnt : 0;
+        int segment = std::min(static_cast<int>(t), std::max(segment_cnt - 1, 0));
+        float alpha = std::min(t - segment, 1.0f);
+        const CameraKeyframe& from = path.keyframes[segment];
+        const CameraKeyframe& to = path.keyframes[(segment + 1) % keyframe_cnt];
+
+        // 2. Move the camera and render the frame
+        camera->moveTo(from.position + alpha * (to.position - from.position));
+        camera->lookAt(from.target + alpha * (to.target - from.target));
+        char suffix[16];
+        snprintf(suffix, sizeof(suffix), "_%04d", f);
+        printf("Rendering Frame %d / %d\n", f + 1, frame_cnt);
+        Pass(suffix);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    printf("Rendered %d frames in %.2f s (%.2f ms per frame)\n", frame_cnt, seconds, seconds * 1e3 / frame_cnt);
+}
+
+/**
+ * @brief 执行光栅化的主要流程，渲染一帧。
+ * @param suffix 输出图像文件名的后缀。
+ * @note 包括清空缓冲区、顶点处理、片元处理、片元着色和图像输出，可重复调用。
+ */
+void Rasterizer::Pass(const std::string& suffix) {
     puts("Passing the Rasterizer");
+    clearFrame();
     VertexProcessing();
     puts("Vertex Processing Done");
     FragmentProcessing();
     puts("Fragment Processing Done");
     FragmentShading();
     puts("Fragment Shading Done");
-    DisplayToImage();
+    DisplayToImage(suffix);
 }
 
 /**
@@ -145,188 +394,705 @@ void Rasterizer::VertexProcessing() {
     // Generate the Matrix
     Mat4f view_matrix = camera->getViewMatrix(),
         projection_matrix = camera->getProjectionMatrix();
+    Mat4f view_projection = projection_matrix * view_matrix;
+    // World space positions are reconstructed from the depth buffer while shading
+    inv_view_projection = view_projection.inverse();
+    // Object Culling: skip the objects whose bounding boxes are outside the view frustum
+    std::vector<const Object*> objects;
+    int64_t object_culled_cnt = 0;
+    for (const std::shared_ptr<Object>& obj : scene->getObjects()) {
+        if (isBoxOutsideFrustum(view_projection, obj->getMinBound(), obj->getMaxBound())) {
+            object_culled_cnt++;
+            continue;
+        }
+        objects.push_back(obj.get());
+    }
+    // Sort the objects front to back so that the hierarchical-z rejects more of the later ones
+    // Objects are ordered by the distance from the camera to their world space bounding boxes
+    Vec3f camera_position = camera->getPosition();
+    auto boxDistance = [&](const Object* obj) {
+        Vec3f closest = camera_position.cwiseMax(obj->getMinBound()).cwiseMin(obj->getMaxBound());
+        return (closest - camera_position).squaredNorm();
+    };
+    std::stable_sort(objects.begin(), objects.end(),
+        [&](const Object* a, const Object* b) {
+            return boxDistance(a) < boxDistance(b);
+        });
     // Get All Vertices
-    for (std::shared_ptr<Object> obj : scene->getObjects()) {
-        std::shared_ptr<Materials> mat = obj->getMaterial();
-        for (Triangle tri : obj->getTriangles()) {
-            org_triangle_buffer.push_back(tri);
-            Triangle new_tri;
-            for (int i = 0; i < 3; i++) {
-                Vertex vert = tri.getVertex(i);
-                Vec4f org_pos = Vec4f(vert.position.x(), vert.position.y(), vert.position.z(), 1),
-                    org_norm = Vec4f(vert.normal.x(), vert.normal.y(), vert.normal.z(), 0);
-                
-                
-                // Apply the Transformation
-                Vertex new_vert = vert;
-                Vec4f pos = projection_matrix * view_matrix * org_pos;
-                Vec4f norm = view_matrix * org_norm;
-                
-                new_vert.position = Vec3f(pos.x() / pos.w(), pos.y() / pos.w(), pos.z() / pos.w());
-                new_vert.normal = Vec3f(norm.x(), norm.y(), norm.z());
-                new_vert.uv = vert.uv;
-
-                new_tri.setVertex(i, new_vert);
-            }
-            new_tri.setMaterial(mat);
-            triangle_buffer.push_back(new_tri);
+    TriangleClipper clipper(camera->getWidth(), camera->getHeight());
+    int64_t input_cnt = 0, rejected_cnt = 0, split_cnt = 0, backface_cnt = 0, degenerate_cnt = 0;
+    auto start_time = std::chrono::steady_clock::now();
+    std::vector<uint32_t> vertex_offsets(objects.size() + 1, 0);
+    for (size_t o = 0; o < objects.size(); o++) {
+        vertex_offsets[o + 1] = vertex_offsets[o] + objects[o]->getPositions().cols();
+    }
+    frame_clip_positions.resize(4, vertex_offsets.back());
+    frame_world_normals.resize(3, vertex_offsets.back());
+    for (size_t o = 0; o < objects.size(); o++) {
+        const Object* obj = objects[o];
+        uint16_t mat_id = scene->getMaterialId(obj->getMaterial());
+        // Apply the Transformation into clip space: one fused model-view-projection matrix,
+        // applied to all vertices of the object in a single matrix product
+        uint32_t offset = vertex_offsets[o], vertex_cnt = vertex_offsets[o + 1] - offset;
+        Mat4f mvp = view_projection * obj->getModelMatrix();
+        frame_clip_positions.middleCols(offset, vertex_cnt).noalias() = mvp * obj->getPositions();
+        frame_world_normals.middleCols(offset, vertex_cnt).noalias() = obj->getNormalMatrix() * obj->getNormals();
+        const std::vector<uint32_t>& indices = obj->getIndices();
+        // Assemble the triangles from the index buffer
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            input_cnt++;
+            FrameTriangle tri{obj, offset, {indices[t], indices[t + 1], indices[t + 2]}, -1};
+            Vec4f clip[3] = {
+                frame_clip_positions.col(offset + tri.indices[0]), frame_clip_positions.col(offset + tri.indices[1]),
+                frame_clip_positions.col(offset + tri.indices[2])
+            };
+            // Clipping: reject triangles outside the frustum, clip the ones crossing the near plane,
+            // and triangulate the clipped polygon as a fan, attributes are interpolated in clip space
+            int polygon_cnt = clipTriangle(clipper, clip, [&](const ClipVertex* const corners[3], const Vec3f ndc[3]) {
+                // Triangle Culling: the winding follows the vertex normals (see Object::localToWorld),
+                // so a negative screen space area means the triangle faces away from the camera
+                float area = (ndc[1].x() - ndc[0].x()) * (ndc[2].y() - ndc[0].y()) -
+                    (ndc[1].y() - ndc[0].y()) * (ndc[2].x() - ndc[0].x());
+                if (area == 0 || !std::isfinite(area)) {
+                    degenerate_cnt++;
+                    return;
+                }
+                if (backface_culling && area < 0) {
+                    backface_cnt++;
+                    return;
+                }
+
+                // Only the corners made by the clipper are stored, the others are the mesh vertices
+                FrameTriangle fan = tri;
+                if (corners[0]->weights != Vec3f::UnitX() || corners[1]->weights != Vec3f::UnitY() ||
+                    corners[2]->weights != Vec3f::UnitZ()) {
+                    ClippedCorners clipped;
+                    for (int i = 0; i < 3; i++) {
+                        clipped.positions[i] = corners[i]->position;
+                        clipped.weights[i] = corners[i]->weights;
+                    }
+                    fan.clipped = clipped_corners.size();
+                    clipped_corners.push_back(clipped);
+                }
+                frame_triangles.push_back(fan);
+                triangle_material_ids.push_back(mat_id);
+            });
+            rejected_cnt += polygon_cnt == 0;
+            split_cnt += polygon_cnt > 3;
         }
     }
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    printf("Vertex Processing: %ld objects culled, %ld triangles in, %ld rejected by the frustum, %ld split by clipping, "
+        "%ld back faces, %ld degenerate, %ld out in %.2f ms\n",
+        static_cast<long>(object_culled_cnt), static_cast<long>(input_cnt), static_cast<long>(rejected_cnt),
+        static_cast<long>(split_cnt), static_cast<long>(backface_cnt), static_cast<long>(degenerate_cnt),
+        static_cast<long>(frame_triangles.size()), elapsed_ms);
+}
+
+/**
+ * @brief 三角形三个角点的 NDC 坐标，由本帧的裁剪空间坐标透视除法得到。
+ */
+void Rasterizer::triangleNDC(uint32_t tid, Vec3f ndc[3]) const {
+    const FrameTriangle& tri = frame_triangles[tid];
+    for (int i = 0; i < 3; i++) {
+        Vec4f clip = tri.clipped < 0 ? Vec4f(frame_clip_positions.col(tri.vertex_offset + tri.indices[i]))
+            : clipped_corners[tri.clipped].positions[i];
+        ndc[i] = clip.head<3>() / clip.w();
+    }
+}
+
+/**
+ * @brief 三角形三个角点的世界坐标法线与纹理坐标。
+ * @note 被裁剪的角点由网格顶点的属性按其重心坐标插值。
+ */
+void Rasterizer::triangleAttributes(uint32_t tid, Vec3f normals[3], Vec2f uvs[3]) const {
+    const FrameTriangle& tri = frame_triangles[tid];
+    const Mat2Xf& mesh_uvs = tri.object->getUVs();
+    for (int i = 0; i < 3; i++) {
+        normals[i] = frame_world_normals.col(tri.vertex_offset + tri.indices[i]);
+        uvs[i] = mesh_uvs.col(tri.indices[i]);
+    }
+    if (tri.clipped < 0) {
+        return;
+    }
+    Vec3f vertex_normals[3] = {normals[0], normals[1], normals[2]};
+    Vec2f vertex_uvs[3] = {uvs[0], uvs[1], uvs[2]};
+    for (int i = 0; i < 3; i++) {
+        const Vec3f& weights = clipped_corners[tri.clipped].weights[i];
+        normals[i] = vertex_normals[0] * weights.x() + vertex_normals[1] * weights.y() + vertex_normals[2] * weights.z();
+        uvs[i] = vertex_uvs[0] * weights.x() + vertex_uvs[1] * weights.y() + vertex_uvs[2] * weights.z();
+    }
 }
 
 /**
  * @brief 片元处理阶段。
- * @note 对每个三角形进行光栅化，计算每个像素的深度、法线、材质等信息。
+ * @note 先将三角形按屏幕包围盒分箱到 RASTER_TILE_SIZE 大小的 Tile 中，
+ *       再以 Tile 为单位并行光栅化。每个线程独占其 Tile 对应的屏幕缓冲区区域，无需加锁。
  */
 void Rasterizer::FragmentProcessing() {
-    uint32_t triangle_cnt = triangle_buffer.size();
-    for (int tid = 0; tid < triangle_cnt; tid++) {
-        //for (Triangle &tri : triangle_buffer)
-        Triangle& tri = triangle_buffer[tid];
-        Triangle& org_tri = org_triangle_buffer[tid];
-        // Get AABB Of the Triangle
-        Vec2f min = tri.getXYMin(), max = tri.getXYMax();
-        float width = static_cast<float>(camera->getWidth()),
-                height = static_cast<float>(camera->getHeight());
-        Vec2i min_screen = Vec2i(
-                    static_cast<int>((min.x() + 1) / 2 * width),
-                    static_cast<int>((min.y() + 1) / 2 * height)),
-                max_screen = Vec2i(
-                    static_cast<int>((max.x() + 1) / 2 * width),
-                    static_cast<int>((max.y() + 1) / 2 * height));
-        // Clip the bounding box
-        min_screen = (min_screen - Vec2i(1, 1)).cwiseMax(Vec2i(0, 0));
-        max_screen = (max_screen + Vec2i(1, 1)).cwiseMin(Vec2i(camera->getWidth(), camera->getHeight()));
-
-        // Rasterize the Triangle
-        int min_x = min_screen.x(), min_y = min_screen.y(),
-            max_x = max_screen.x(), max_y = max_screen.y();
-        for (int x = min_x; x < max_x; x++) {
-            for (int y = min_y; y < max_y; y++) {
-                Vec3f pos = Vec3f(
-                    2 * static_cast<float>(x) / width - 1,
-                    2 * static_cast<float>(y) / height - 1,
-                    0);
-                
-                int w = camera->getWidth(), h = camera->getHeight();
-                if (tri.isInsidefor2D(pos)) {
-                    // Interpolation Weights
-                    Vec3f weights = tri.getInterpolationWeightsfor2D(pos);
-                    // Check weights valid
-                    if (!utils::isValidWeight(weights)) {
-                        continue;
-                    }
-                    // Depth
-                    float depth = weights.x() * tri.getVertex(0).position.z() +
-                                    weights.y() * tri.getVertex(1).position.z() +
-                                    weights.z() * tri.getVertex(2).position.z();
-                    // Check the Depth Buffer
-                    if (std::abs((depth - 1) / 2) >= depth_buffer[y * w + x]) {
-                        continue;
-                    }
-                    // Write to the Depth Buffer
-                    depth_buffer[y * w + x] = std::abs((depth - 1) / 2);
-
-                    /*
-                    We save the original information (In the global / world space) of the fragment
-                    We also save the information in the camera space
-                    */
-                    // Position
-                    Vec3f position = weights.x() * tri.getVertex(0).position +
-                                        weights.y() * tri.getVertex(1).position +
-                                        weights.z() * tri.getVertex(2).position;
-                    position_buffer[y * w + x] = position;
-                    Vec3f org_position = weights.x() * org_tri.getVertex(0).position +
-                                        weights.y() * org_tri.getVertex(1).position +
-                                        weights.z() * org_tri.getVertex(2).position;
-                    org_position_buffer[y * w + x] = org_position;
-                    // Normal
-                    Vec3f normal = weights.x() * tri.getVertex(0).normal +
-                                    weights.y() * tri.getVertex(1).normal +
-                                    weights.z() * tri.getVertex(2).normal;
-                    normal_buffer[y * w + x] = normal;
-                    Vec3f org_normal = weights.x() * org_tri.getVertex(0).normal +
-                                    weights.y() * org_tri.getVertex(1).normal +
-                                    weights.z() * org_tri.getVertex(2).normal;
-                    org_normal_buffer[y * w + x] = org_normal;
-                    // uv
-                    Vec2f uv = weights.x() * tri.getVertex(0).uv +
-                                weights.y() * tri.getVertex(1).uv +
-                                weights.z() * tri.getVertex(2).uv;
-                    uv_buffer[y * w + x] = uv;
-                    // Material
-                    material_buffer[y * w + x] = tri.getMaterial();
+    int w = camera->getWidth(), h = camera->getHeight();
+    int tiles_x = (w + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE,
+        tiles_y = (h + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    int num_tiles = tiles_x * tiles_y;
+    uint32_t triangle_cnt = frame_triangles.size();
+
+    // 1. Binning: each thread bins a contiguous range of triangles into its own bins,
+    //    so that walking the bins in thread order keeps the submission order.
+    int num_threads = omp_get_max_threads();
+    triangle_setups.assign(triangle_cnt, TriangleSetup());
+    std::vector<std::vector<std::vector<uint32_t>>> bins(
+        num_threads, std::vector<std::vector<uint32_t>>(num_tiles)
+    );
+    #pragma omp parallel num_threads(num_threads)
+    {
+        std::vector<std::vector<uint32_t>>& local_bins = bins[omp_get_thread_num()];
+        #pragma omp for schedule(static)
+        for (int tid = 0; tid < static_cast<int>(triangle_cnt); tid++) {
+            Vec3f ndc[3];
+            triangleNDC(tid, ndc);
+            // Triangle Setup: edge equations and bounding box, once per triangle
+            TriangleSetup& setup = triangle_setups[tid];
+            if (!setup.setup(ndc[0], ndc[1], ndc[2], w, h)) {
+                continue;
+            }
+            for (int ty = setup.min_y / RASTER_TILE_SIZE; ty <= (setup.max_y - 1) / RASTER_TILE_SIZE; ty++) {
+                for (int tx = setup.min_x / RASTER_TILE_SIZE; tx <= (setup.max_x - 1) / RASTER_TILE_SIZE; tx++) {
+                    local_bins[ty * tiles_x + tx].push_back(tid);
                 }
             }
         }
     }
+
+    // 2. Rasterize each tile in parallel
+    //    The hierarchical-z cells of a tile are owned by the tile's worker as well.
+    hiz_buffer.reset(w, h, 1);
+    auto start_time = std::chrono::steady_clock::now();
+    int64_t fragment_cnt = 0, hiz_culled_cnt = 0;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+: fragment_cnt, hiz_culled_cnt)
+    for (int tile = 0; tile < num_tiles; tile++) {
+        int tile_min_x = (tile % tiles_x) * RASTER_TILE_SIZE,
+            tile_min_y = (tile / tiles_x) * RASTER_TILE_SIZE;
+        int tile_max_x = std::min(tile_min_x + RASTER_TILE_SIZE, w),
+            tile_max_y = std::min(tile_min_y + RASTER_TILE_SIZE, h);
+        int rasterized = 0;
+        for (int t = 0; t < num_threads; t++) {
+            for (uint32_t tid : bins[t][tile]) {
+                const TriangleSetup& setup = triangle_setups[tid];
+                int min_x = std::max(setup.min_x, tile_min_x), min_y = std::max(setup.min_y, tile_min_y),
+                    max_x = std::min(setup.max_x, tile_max_x), max_y = std::min(setup.max_y, tile_max_y);
+                // Coarse rejection: the triangle is behind everything drawn in this part of the tile
+                if (setup.min_depth >= hiz_buffer.regionMax(min_x, min_y, max_x, max_y)) {
+                    hiz_culled_cnt++;
+                    continue;
+                }
+                fragment_cnt += RasterizeTriangle(tid, setup, min_x, min_y, max_x, max_y);
+                if (++rasterized % RASTER_HIZ_REFRESH == 0) {
+                    hiz_buffer.refresh(depth_buffer, tile_min_x, tile_min_y, tile_max_x, tile_max_y);
+                }
+            }
+        }
+    }
+
+    auto end_time = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end_time - start_time).count();
+    printf("Rasterized %ld fragments in %.2f ms (%.1f MFragments/s, %s kernel), HiZ culled %ld triangle tiles\n",
+        static_cast<long>(fragment_cnt), seconds * 1e3, fragment_cnt / seconds / 1e6,
+        rasterUseAVX2() ? "AVX2" : "scalar", static_cast<long>(hiz_culled_cnt));
+}
+
+/**
+ * @brief 以 HiZ 单元为粒度光栅化三角形，跳过三角形不可能通过深度测试的单元。
+ * @param fragment 传给光栅化内核的片元回调。
+ * @return 被三角形覆盖的像素数。
+ */
+template <typename FragmentFunc>
+int Rasterizer::RasterizeCells(
+    const TriangleSetup& setup, int min_x, int min_y, int max_x, int max_y, FragmentFunc&& fragment
+) {
+    int w = camera->getWidth();
+    // Walk the hierarchical-z cells row by row, skipping cells in which the triangle
+    // cannot pass the depth test, and rasterize each run of remaining cells at once.
+    // Coverage, depth test and depth write happen in the raster kernel.
+    int covered = 0;
+    for (int cy = min_y / RASTER_HIZ_CELL; cy <= (max_y - 1) / RASTER_HIZ_CELL; cy++) {
+        int run_min_y = std::max(min_y, cy * RASTER_HIZ_CELL),
+            run_max_y = std::min(max_y, (cy + 1) * RASTER_HIZ_CELL);
+        int cx_begin = min_x / RASTER_HIZ_CELL, cx_end = (max_x - 1) / RASTER_HIZ_CELL + 1;
+        for (int cx = cx_begin; cx < cx_end; cx++) {
+            if (setup.min_depth >= hiz_buffer.cellMax(cx, cy)) {
+                continue;
+            }
+            int run_begin = cx;
+            while (cx + 1 < cx_end && setup.min_depth < hiz_buffer.cellMax(cx + 1, cy)) {
+                cx++;
+            }
+            int run_covered = rasterizeTriangle(
+                setup,
+                std::max(min_x, run_begin * RASTER_HIZ_CELL), run_min_y,
+                std::min(max_x, (cx + 1) * RASTER_HIZ_CELL), run_max_y,
+                depth_buffer.data(), w, 0, fragment
+            );
+            if (run_covered > 0) {
+                for (int c = run_begin; c <= cx; c++) {
+                    hiz_buffer.markDirty(c, cy);
+                }
+            }
+            covered += run_covered;
+        }
+    }
+    return covered;
+}
+
+/**
+ * @brief 在给定的屏幕矩形内光栅化单个三角形。
+ * @param tid 三角形在 frame_triangles 中的下标。
+ * @param setup 该三角形的 TriangleSetup。
+ * @param min_x, min_y, max_x, max_y 光栅化的像素范围（左闭右开）。
+ * @return 被三角形覆盖的像素数。
+ * @note 只写入该矩形内的屏幕缓冲区，调用者需保证矩形不会被其他线程同时写入。
+ */
+int Rasterizer::RasterizeTriangle(
+    uint32_t tid, const TriangleSetup& setup, int min_x, int min_y, int max_x, int max_y
+) {
+    int w = camera->getWidth();
+    if (pipeline == Visibility_Pipeline) {
+        // Only the triangle index is written, the attributes are resolved in FragmentShading
+        return RasterizeCells(setup, min_x, min_y, max_x, max_y, DepthIdAttributes{visibility_buffer.data(), w, tid});
+    }
+
+    // Only the world space normal, uv and material id are stored, see GBuffer
+    GBufferAttributes attributes{&g_buffer, w, triangle_material_ids[tid], {}, {}};
+    triangleAttributes(tid, attributes.normals, attributes.uvs);
+    return RasterizeCells(setup, min_x, min_y, max_x, max_y, attributes);
+}
+
+/**
+ * @brief 取出像素上的片元属性。
+ * @param idx 像素下标。
+ * @param material_id 输出的材质编号，物体没有材质时为 MATERIAL_NONE。
+ * @param normal 输出的世界坐标系单位法线。
+ * @param uv 输出的纹理坐标。
+ * @return 像素被三角形覆盖时返回 true。
+ * @note 前向流水线从 G-Buffer 解码，可见性缓冲流水线由三角形重新插值。
+ */
+bool Rasterizer::ResolveFragment(int idx, uint16_t& material_id, Vec3f& normal, Vec2f& uv) const {
+    if (pipeline == Visibility_Pipeline) {
+        // Resolve the attributes from the triangle that won the depth test
+        uint32_t tid = visibility_buffer[idx];
+        if (tid == RASTER_INVALID_ID) {
+            return false;
+        }
+        int w = camera->getWidth();
+        Vec3f weights = triangle_setups[tid].weightsAt(idx % w, idx / w);
+        Vec3f normals[3];
+        Vec2f uvs[3];
+        triangleAttributes(tid, normals, uvs);
+        normal = (weights.x() * normals[0] + weights.y() * normals[1] + weights.z() * normals[2]).normalized();
+        uv = weights.x() * uvs[0] + weights.y() * uvs[1] + weights.z() * uvs[2];
+        material_id = triangle_material_ids[tid];
+        return true;
+    }
+    // The depth test is strict, so only uncovered pixels keep the clear value
+    if (depth_buffer[idx] >= 1) {
+        return false;
+    }
+    material_id = g_buffer.material[idx];
+    normal = g_buffer.normalAt(idx);
+    uv = g_buffer.uvAt(idx);
+    return true;
+}
+
+/**
+ * @brief 分块分簇的光源剔除，为每个簇建立光源列表。
+ * @param light_centers, light_radii 每个光源影响范围的包围球，半径为无穷大时光源照亮所有簇。
+ * @note 屏幕被分为 LIGHT_TILE_SIZE 大小的块，每块按像素到相机的距离分为 LIGHT_CLUSTER_SLICES 层。
+ *       每个簇的包围盒由其覆盖像素的世界坐标得到，与包围球相交的光源按编号顺序加入簇的列表。
+ */
+void Rasterizer::CullLights(const std::vector<Vec3f>& light_centers, const std::vector<float>& light_radii) {
+    int w = camera->getWidth(), h = camera->getHeight();
+    light_tiles_x = (w + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+    int tiles_y = (h + LIGHT_TILE_SIZE - 1) / LIGHT_TILE_SIZE;
+    int num_tiles = light_tiles_x * tiles_y, num_lights = light_centers.size();
+    Vec3f camera_position = camera->getPosition();
+    tile_near.assign(num_tiles, 0);
+    tile_slice_scale.assign(num_tiles, 0);
+    cluster_lights.assign(num_tiles * LIGHT_CLUSTER_SLICES, std::vector<uint32_t>());
+
+    int64_t list_cnt = 0, cluster_cnt = 0;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+: list_cnt, cluster_cnt)
+    for (int tile = 0; tile < num_tiles; tile++) {
+        int x0 = (tile % light_tiles_x) * LIGHT_TILE_SIZE, y0 = (tile / light_tiles_x) * LIGHT_TILE_SIZE;
+        int x1 = std::min(x0 + LIGHT_TILE_SIZE, w), y1 = std::min(y0 + LIGHT_TILE_SIZE, h);
+
+        // 1. World positions and view distances of the covered pixels, and the distance range of the tile
+        Vec3f positions[LIGHT_TILE_SIZE * LIGHT_TILE_SIZE];
+        float distances[LIGHT_TILE_SIZE * LIGHT_TILE_SIZE];
+        int covered_cnt = 0;
+        float near = INFINITY, far = 0;
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                float depth = depth_buffer[y * w + x];
+                if (depth >= 1) {
+                    continue;
+                }
+                positions[covered_cnt] = reconstructPosition(inv_view_projection, 2.0f * x / w - 1, 2.0f * y / h - 1, depth);
+                distances[covered_cnt] = (positions[covered_cnt] - camera_position).norm();
+                near = std::min(near, distances[covered_cnt]);
+                far = std::max(far, distances[covered_cnt]);
+                covered_cnt++;
+            }
+        }
+        if (covered_cnt == 0) {
+            continue;
+        }
+        tile_near[tile] = near;
+        tile_slice_scale[tile] = LIGHT_CLUSTER_SLICES / std::max(far - near, 1e-6f);
+
+        // 2. Bounding box of each slice
+        Vec3f min_bound[LIGHT_CLUSTER_SLICES], max_bound[LIGHT_CLUSTER_SLICES];
+        std::fill(min_bound, min_bound + LIGHT_CLUSTER_SLICES, Vec3f::Constant(INFINITY));
+        std::fill(max_bound, max_bound + LIGHT_CLUSTER_SLICES, Vec3f::Constant(-INFINITY));
+        for (int i = 0; i < covered_cnt; i++) {
+            int slice = std::min(static_cast<int>((distances[i] - near) * tile_slice_scale[tile]), LIGHT_CLUSTER_SLICES - 1);
+            min_bound[slice] = min_bound[slice].cwiseMin(positions[i]);
+            max_bound[slice] = max_bound[slice].cwiseMax(positions[i]);
+        }
+
+        // 3. Keep the lights whose influence spheres touch the slice
+        for (int slice = 0; slice < LIGHT_CLUSTER_SLICES; slice++) {
+            if (min_bound[slice].x() > max_bound[slice].x()) {
+                continue;
+            }
+            std::vector<uint32_t>& lights = cluster_lights[tile * LIGHT_CLUSTER_SLICES + slice];
+            for (int l = 0; l < num_lights; l++) {
+                Vec3f closest = light_centers[l].cwiseMax(min_bound[slice]).cwiseMin(max_bound[slice]);
+                if ((closest - light_centers[l]).squaredNorm() <= light_radii[l] * light_radii[l]) {
+                    lights.push_back(l);
+                }
+            }
+            list_cnt += lights.size();
+            cluster_cnt++;
+        }
+    }
+    printf("Light Culling: %ld clusters, %.2f of %d lights per cluster\n",
+        static_cast<long>(cluster_cnt), cluster_cnt ? static_cast<double>(list_cnt) / cluster_cnt : 0.0, num_lights);
 }
 
 /**
  * @brief 片元着色阶段。
  * @note 根据光照模型计算每个像素的颜色。
+ *       光源与 VPL 每帧展开一次为连续数组，之后按行并行着色，内层循环不做堆分配。
+ *       每个像素只遍历其所在簇的光源列表。
+ *       随机着色模式下每个光源只分层抽取 vpl_samples 个 VPL，着色后再做联合双边滤波。
+ *       间接光照从反射阴影贴图生成的间接光 VPL 中收集，每个像素按交错采样只计算其中一组，同样经过滤波；
+ *       启用辐照度探针时改为从探针网格中插值。
  */
 void Rasterizer::FragmentShading() {
-    uint32_t resolution = camera->getWidth() * camera->getHeight();
-    for (int i = 0; i < resolution; i++) {
-        // Get each fragment, and do the shading
-        Vec3f position = org_position_buffer[i],
-            normal = org_normal_buffer[i];
-        Vec2f uv = uv_buffer[i];
-        std::shared_ptr<Materials> mat = material_buffer[i];
-        // Check if the material is nullptr
-        if (mat == nullptr) {
+    int w = camera->getWidth(), h = camera->getHeight();
+    Vec3f camera_position = camera->getPosition();
+
+    // 1. Flatten the lights and their direct VPLs into contiguous arrays, once per frame
+    //    Light l owns the VPLs [vpl_begin[l], vpl_begin[l + 1])
+    const std::vector<std::shared_ptr<Light>>& lights = scene->getLights();
+    std::vector<uint32_t> vpl_begin(1, 0);
+    std::vector<Vec3f> vpl_positions, vpl_intensities;
+    for (const std::shared_ptr<Light>& light : lights) {
+        for (const DirectVPL& d_vpl : light->getDirectVPLs()) {
+            vpl_positions.push_back(d_vpl.position);
+            vpl_intensities.push_back(d_vpl.intensity);
+        }
+        vpl_begin.push_back(vpl_positions.size());
+    }
+    int num_lights = lights.size();
+    // Indirect VPLs from the reflective shadow maps, light l owns [indirect_begin[l], indirect_begin[l + 1]),
+    // split into RSM_INTERLEAVE * RSM_INTERLEAVE sets of indirect_samples VPLs
+    std::vector<uint32_t> indirect_begin(1, 0);
+    std::vector<Vec3f> indirect_positions, indirect_normals, indirect_fluxes;
+    for (const std::shared_ptr<Light>& light : lights) {
+        for (const IndirectVPL& i_vpl : light->getIndirectVPLs()) {
+            indirect_positions.push_back(i_vpl.position);
+            indirect_normals.push_back(i_vpl.normal);
+            indirect_fluxes.push_back(i_vpl.flux);
+        }
+        indirect_begin.push_back(indirect_positions.size());
+    }
+    // With irradiance probes the indirect light is looked up instead
+    bool indirect = !indirect_positions.empty() && probe_grid.empty();
+
+    // 2. Influence spheres of the lights, bounding the spheres of their VPLs
+    //    Without falloff a light reaches everything
+    std::vector<float> vpl_radii(vpl_positions.size(), INFINITY);
+    std::vector<Vec3f> light_centers(num_lights);
+    std::vector<float> light_radii(num_lights, INFINITY);
+    for (int l = 0; l < num_lights; l++) {
+        Vec3f min_bound = Vec3f::Constant(INFINITY), max_bound = Vec3f::Constant(-INFINITY);
+        for (uint32_t k = vpl_begin[l]; k < vpl_begin[l + 1]; k++) {
+            min_bound = min_bound.cwiseMin(vpl_positions[k]);
+            max_bound = max_bound.cwiseMax(vpl_positions[k]);
+        }
+        light_centers[l] = (min_bound + max_bound) / 2;
+        if (!light_falloff) {
             continue;
         }
+        light_radii[l] = 0;
+        for (uint32_t k = vpl_begin[l]; k < vpl_begin[l + 1]; k++) {
+            vpl_radii[k] = influenceRadius(vpl_intensities[k]);
+            light_radii[l] = std::max(light_radii[l], (vpl_positions[k] - light_centers[l]).norm() + vpl_radii[k]);
+        }
+    }
+    CullLights(light_centers, light_radii);
 
-        // Shading
-        Vec3f vert_color = mat->evalColor(uv);
-        float shininess = mat->evalShininess();
-        // Ambient Light
-        Vec3f color = AMBIENT.cwiseProduct(vert_color);
-        // Diffuse and Specular Light
-        auto lights = scene->getLights();
-        for (std::shared_ptr<Light> light : lights) {
-            if (!light->isLighted(position)) {
-                continue;
+    // Stochastic direct light and interleaved indirect light are noisy, the noisy radiance is kept
+    // with the albedo and the filter guides for the denoiser
+    bool stochastic = vpl_samples > 0;
+    bool filter_noise = denoise && (stochastic || indirect);
+    std::vector<Vec3f> noisy_radiance, albedo, guide_normals;
+    std::vector<float> guide_distances;
+    if (filter_noise) {
+        noisy_radiance.assign(w * h, Vec3f::Zero());
+        albedo.assign(w * h, Vec3f::Zero());
+        guide_normals.assign(w * h, Vec3f::Zero());
+        guide_distances.assign(w * h, INFINITY);
+    }
+
+    // 3. Shade the rows in parallel
+    auto start_time = std::chrono::steady_clock::now();
+    int64_t vpl_eval_cnt = 0, indirect_eval_cnt = 0;
+    #pragma omp parallel reduction(+: vpl_eval_cnt, indirect_eval_cnt)
+    {
+        // Row buffers of the thread, reused across rows
+        std::vector<uint8_t> row_shaded(w);
+        std::vector<uint16_t> row_materials(w);
+        std::vector<Vec3f> row_positions(w), row_normals(w);
+        std::vector<Vec2f> row_uvs(w);
+        std::vector<float> row_distances(w);
+        std::vector<uint32_t> row_clusters(w);
+        // Shadow visibility of the row: pixel x owns one entry per light of its cluster,
+        // starting at row_visibility_begin[x]
+        std::vector<uint32_t> row_visibility_begin(w + 1);
+        std::vector<float> row_visibility, batch_visibility;
+        // Per light: the positions to test and their entries in row_visibility
+        std::vector<std::vector<Vec3f>> light_positions(num_lights);
+        std::vector<std::vector<uint32_t>> light_slots(num_lights);
+        std::vector<uint32_t> row_lights;
+        #pragma omp for schedule(dynamic, 1)
+        for (int y = 0; y < h; y++) {
+            // 3.1. Resolve the fragments of the row, and find their clusters
+            for (int x = 0; x < w; x++) {
+                int i = y * w + x;
+                uint32_t light_cnt = 0;
+                // Check if the fragment is covered and has a material
+                row_shaded[x] = ResolveFragment(i, row_materials[x], row_normals[x], row_uvs[x]) && row_materials[x] != MATERIAL_NONE;
+                if (row_shaded[x]) {
+                    row_positions[x] = reconstructPosition(
+                        inv_view_projection, 2.0f * x / w - 1, 2.0f * y / h - 1, depth_buffer[i]
+                    );
+                    row_distances[x] = (camera_position - row_positions[x]).norm();
+                    row_clusters[x] = clusterAt(x, y, row_distances[x]);
+                    light_cnt = cluster_lights[row_clusters[x]].size();
+                }
+                row_visibility_begin[x + 1] = row_visibility_begin[x] + light_cnt;
+            }
+
+            // 3.2. Shadow visibility, one batched shadow map lookup per light over the pixels whose clusters list it
+            row_visibility.resize(row_visibility_begin[w]);
+            for (int x = 0; x < w; x++) {
+                if (!row_shaded[x]) {
+                    continue;
+                }
+                const std::vector<uint32_t>& cluster = cluster_lights[row_clusters[x]];
+                for (size_t k = 0; k < cluster.size(); k++) {
+                    uint32_t l = cluster[k];
+                    if (light_slots[l].empty()) {
+                        row_lights.push_back(l);
+                    }
+                    light_positions[l].push_back(row_positions[x]);
+                    light_slots[l].push_back(row_visibility_begin[x] + k);
+                }
+            }
+            for (uint32_t l : row_lights) {
+                batch_visibility.resize(light_slots[l].size());
+                lights[l]->getVisibility(light_positions[l].data(), light_positions[l].size(), batch_visibility.data());
+                for (size_t j = 0; j < light_slots[l].size(); j++) {
+                    row_visibility[light_slots[l][j]] = batch_visibility[j];
+                }
+                light_positions[l].clear();
+                light_slots[l].clear();
             }
+            row_lights.clear();
+
+            // 3.3. Shade the fragments of the row
+            for (int x = 0; x < w; x++) {
+                if (!row_shaded[x]) {
+                    continue;
+                }
+                int i = y * w + x;
+                const Materials& mat = *scene->getMaterial(row_materials[x]);
+                const Vec3f& position = row_positions[x], & normal = row_normals[x];
+                const Vec2f& uv = row_uvs[x];
+                // The normal from ResolveFragment is already unit length
+                float camera_distance = row_distances[x];
+                Vec3f view_dir = (camera_position - position) / camera_distance;
+
+                // Shading
+                Vec3f vert_color = mat.evalColor(uv);
+                float shininess = mat.evalShininess();
+                // Contribution of a VPL with the given intensity and influence radius
+                auto shadeVPL = [&](const Vec3f& vpl_position, const Vec3f& intensity, float radius) -> Vec3f {
+                    vpl_eval_cnt++;
+                    Vec3f to_light = vpl_position - position;
+                    float distance_sq = to_light.squaredNorm();
+                    if (distance_sq == 0 || distance_sq >= radius * radius) {
+                        return Vec3f::Zero();
+                    }
+                    Vec3f light_dir = to_light / std::sqrt(distance_sq);
+                    float weight = 0;
+                    // Diffuse Shading
+                    float cos_theta_diffuse = light_dir.dot(normal);
+                    if (cos_theta_diffuse > 0) {
+                        weight += cos_theta_diffuse;
+                    }
+                    // Specular Shading
+                    Vec3f half_vec = (view_dir + light_dir).normalized();
+                    float cos_theta_specular = half_vec.dot(normal);
+                    if (cos_theta_specular > 0) {
+                        weight += std::pow(cos_theta_specular, shininess);
+                    }
+                    if (light_falloff) {
+                        weight *= distanceFalloff(distance_sq, radius);
+                    }
+                    return intensity * weight;
+                };
+                // Mirror direction of the view, bounds the specular lobe of VPL clusters
+                Vec3f reflect_dir = 2 * view_dir.dot(normal) * normal - view_dir;
+                // Diffuse and Specular Light, the albedo is applied once at the end
+                Vec3f radiance = Vec3f::Zero();
+                const std::vector<uint32_t>& cluster = cluster_lights[row_clusters[x]];
+                for (size_t c = 0; c < cluster.size(); c++) {
+                    uint32_t l = cluster[c];
+                    float visibility = row_visibility[row_visibility_begin[x] + c];
+                    if (visibility <= 0) {
+                        continue;
+                    }
+
+                    // Direct Shading, scaled by the (fractional) shadow visibility of the light
+                    Vec3f direct_radiance = Vec3f::Zero();
+                    uint32_t vpl_cnt = vpl_begin[l + 1] - vpl_begin[l];
+                    if (stochastic && vpl_cnt > static_cast<uint32_t>(vpl_samples)) {
+                        // Stratified subsampling: one VPL from each of vpl_samples equal strata of the light's VPLs,
+                        // offset per pixel by interleaved gradient noise and weighted by the stratum size
+                        float noise = interleavedGradientNoise(x, y);
+                        float stratum_size = static_cast<float>(vpl_cnt) / vpl_samples;
+                        for (int s = 0; s < vpl_samples; s++) {
+                            float u = noise + s * 0.618034f;
+                            u -= std::floor(u);
+                            uint32_t k = vpl_begin[l] + std::min(static_cast<uint32_t>((s + u) * stratum_size), vpl_cnt - 1);
+                            direct_radiance += stratum_size * shadeVPL(vpl_positions[k], vpl_intensities[k], vpl_radii[k]);
+                        }
+                    }
+                    else if (lightcuts_tolerance > 0 && vpl_cnt > 1) {
+                        // Evaluate a cut of the light's VPL tree, a cluster is shaded from its representative
+                        direct_radiance += lights[l]->getLightTree().evaluateCut(
+                            position, normal, reflect_dir, shininess, lightcuts_tolerance, light_falloff,
+                            [&](const Vec3f& vpl_position, const Vec3f& intensity) {
+                                return shadeVPL(vpl_position, intensity, light_falloff ? influenceRadius(intensity) : INFINITY);
+                            }
+                        );
+                    }
+                    else {
+                        for (uint32_t k = vpl_begin[l]; k < vpl_begin[l + 1]; k++) {
+                            direct_radiance += shadeVPL(vpl_positions[k], vpl_intensities[k], vpl_radii[k]);
+                        }
+                    }
+                    radiance += visibility * direct_radiance;
+                }
+
+                // Indirect Shading: one bounce from the indirect VPLs of the reflective shadow maps, without visibility
+                // Interleaved sampling: the pixel gathers only the VPL set of its position in the pattern,
+                // neighbouring pixels use disjoint sets and the denoiser blends them
+                Vec3f indirect_radiance = Vec3f::Zero();
+                if (!probe_grid.empty()) {
+                    radiance += probe_grid.evalIrradiance(position, normal);
+                }
+                else if (indirect) {
+                    uint32_t set = (y % RSM_INTERLEAVE) * RSM_INTERLEAVE + x % RSM_INTERLEAVE;
+                    for (int l = 0; l < num_lights; l++) {
+                        if (indirect_begin[l + 1] == indirect_begin[l]) {
+                            continue;
+                        }
+                        uint32_t begin = indirect_begin[l] + set * indirect_samples;
+                        for (uint32_t k = begin; k < begin + indirect_samples; k++) {
+                            Vec3f to_vpl = indirect_positions[k] - position;
+                            float distance_sq = to_vpl.squaredNorm();
+                            // Unnormalized cosines at the receiver and at the VPL
+                            float cos_receiver = to_vpl.dot(normal), cos_vpl = -to_vpl.dot(indirect_normals[k]);
+                            if (cos_receiver <= 0 || cos_vpl <= 0) {
+                                continue;
+                            }
+                            // A diffuse VPL emits flux * cos / pi per unit solid angle
+                            float geometry = cos_receiver * cos_vpl /
+                                (distance_sq * std::max(distance_sq, RSM_MIN_DISTANCE * RSM_MIN_DISTANCE) * static_cast<float>(M_PI));
+                            indirect_radiance += indirect_fluxes[k] * geometry;
+                        }
+                        indirect_eval_cnt += indirect_samples;
+                    }
+                }
 
-            // Direct Shading
-            std::vector<DirectVPL> d_vpls = light->getDirectVPLs();
-            for (DirectVPL d_vpl : d_vpls) {
-                Vec3f light_dir = d_vpl.position - position;
-                light_dir.normalize();
-                // Diffuse Shading
-                float cos_theta_diffuse = light_dir.dot(normal.normalized());
-                if (cos_theta_diffuse > 0) {
-                    color += d_vpl.intensity.cwiseProduct(vert_color) * cos_theta_diffuse;
+                if (filter_noise) {
+                    // The noisy part is added back after denoising
+                    Vec3f noisy = indirect_radiance;
+                    if (stochastic) {
+                        noisy += radiance;
+                        radiance.setZero();
+                    }
+                    noisy_radiance[i] = noisy;
+                    albedo[i] = vert_color;
+                    guide_normals[i] = normal;
+                    guide_distances[i] = camera_distance;
                 }
-                // Specular Shading
-                Vec3f view_dir = camera->getPosition() - position;
-                view_dir.normalize();
-                Vec3f half_vec = (view_dir + light_dir).normalized();
-                float cos_theta_specular = half_vec.dot(normal.normalized());
-                if (cos_theta_specular > 0) {
-                    color += d_vpl.intensity.cwiseProduct(vert_color) * pow(cos_theta_specular, shininess);
+                else {
+                    radiance += indirect_radiance;
                 }
+                // Ambient Light
+                color_buffer[i] = (AMBIENT + radiance).cwiseProduct(vert_color);
             }
-            // Indirect Shading
-            std::vector<IndirectVPL> i_vpls = light->getIndirectVPLs();
-            // TODO: Implement Indirect Shading
+        }
+    }
 
+    auto end_time = std::chrono::steady_clock::now();
+    printf("Shaded %d pixels with %d lights and %ld VPLs (%ld VPL evaluations) in %.2f ms\n",
+        w * h, num_lights, static_cast<long>(vpl_positions.size()), static_cast<long>(vpl_eval_cnt),
+        std::chrono::duration<double>(end_time - start_time).count() * 1e3);
+    if (indirect) {
+        printf("Gathered %ld indirect VPLs (%ld evaluations)\n",
+            static_cast<long>(indirect_positions.size()), static_cast<long>(indirect_eval_cnt));
+    }
+
+    // 4. Denoise the stochastic and indirect radiance, guided by normals and view distances
+    //    The albedo is applied after filtering, so that textures stay sharp
+    if (filter_noise) {
+        start_time = std::chrono::steady_clock::now();
+        jointBilateralFilter(noisy_radiance, guide_normals, guide_distances, w, h);
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < w * h; i++) {
+            if (std::isfinite(guide_distances[i])) {
+                color_buffer[i] += noisy_radiance[i].cwiseProduct(albedo[i]);
+            }
         }
-        color_buffer[i] = color;
+        end_time = std::chrono::steady_clock::now();
+        printf("Denoised in %.2f ms\n", std::chrono::duration<double>(end_time - start_time).count() * 1e3);
     }
 }
 
 /**
  * @brief 将缓冲区中的数据保存为图像文件。
+ * @param suffix 文件名后缀，例如 "_0001" 对应 color_0001.png。
  * @note 包括颜色缓冲区、深度缓冲区和法线缓冲区。
  */
-void Rasterizer::DisplayToImage() {
+void Rasterizer::DisplayToImage(const std::string& suffix) {
     std::vector<float> depth_buffer_normal = depth_buffer;
     // Write Color Buffer
-    writeImageToFile(color_buffer, camera->getResolution(), "color.png");
+    writeImageToFile(color_buffer, camera->getResolution(), "color" + suffix + ".png");
     // Write Depth Buffer
     // Get min_value and max_value
     float min_value = 1, max_value = 0;
@@ -339,7 +1105,17 @@ void Rasterizer::DisplayToImage() {
     for (int i = 0; i < camera->getWidth() * camera->getHeight(); i++) {
         depth_buffer_normal[i] = (depth_buffer[i] - min_value) / (max_value-min_value);
     }
-    writeImageToFile(depth_buffer_normal, camera->getResolution(), "depth.png");
-    // Write Normal Buffer
-    writeImageToFile(normal_buffer, camera->getResolution(), "normal.png");
+    writeImageToFile(depth_buffer_normal, camera->getResolution(), "depth" + suffix + ".png");
+    // Write Normal Buffer: camera space normals
+    std::vector<Vec3f> normal_image(camera->getWidth() * camera->getHeight(), Vec3f::Zero());
+    Mat3f view_rotation = camera->getViewMatrix().topLeftCorner<3, 3>();
+    for (int i = 0; i < camera->getWidth() * camera->getHeight(); i++) {
+        uint16_t mat_id;
+        Vec3f normal;
+        Vec2f uv;
+        if (ResolveFragment(i, mat_id, normal, uv)) {
+            normal_image[i] = view_rotation * normal;
+        }
+    }
+    writeImageToFile(normal_image, camera->getResolution(), "normal" + suffix + ".png");
 }
\ No newline at end of file
@@ -5,48 +5,98 @@
 #include "camera.hpp"
 #include "scene.hpp"
 #include "configs.hpp"
+#include "rastercore.hpp"
+#include "hiz.hpp"
+#include "probegrid.hpp"
+
+/**
+ * @brief 通过裁剪与剔除的三角形，按下标引用网格与本帧批量变换后的顶点，不复制顶点属性。
+ */
+struct FrameTriangle {
+    const Object* object;
+    uint32_t vertex_offset; // first column of the object in the frame's vertex buffers
+    uint32_t indices[3]; // vertex indices in the object's mesh
+    int32_t clipped; // index into the clipped corners, -1 when the corners are the mesh vertices
+};
+
+/**
+ * @brief 被裁剪三角形的角点：裁剪空间坐标，以及相对输入三角形的重心坐标。
+ */
+struct ClippedCorners {
+    Vec4f positions[3];
+    Vec3f weights[3];
+};
 
 class Rasterizer {
     std::shared_ptr<Camera> camera;
     std::shared_ptr<Scene> scene;
+    PipelineType pipeline = Forward_Pipeline;
+    bool backface_culling = false;
+    bool light_falloff = false;
+    float lightcuts_tolerance = 0;
+    int vpl_samples = 0;
+    bool denoise = true;
+    int indirect_samples = 0;
+    CameraPathConfig camera_path;
+    IrradianceProbeGrid probe_grid; // indirect light of the static scene, empty when the VPLs are gathered per pixel
 
-    /* Triangle Buffer */
-    std::vector<Triangle> triangle_buffer;
-    std::vector<Triangle> org_triangle_buffer;
+    /* Triangle Buffer: the vertices of the visible objects are transformed in batches, one column range per object */
+    Mat4Xf frame_clip_positions;
+    Mat3Xf frame_world_normals;
+    std::vector<FrameTriangle> frame_triangles;
+    std::vector<ClippedCorners> clipped_corners; // only the triangles cut by the clipper
+    std::vector<TriangleSetup> triangle_setups;
+    std::vector<uint16_t> triangle_material_ids; // index into the scene material table
+    Mat4f inv_view_projection;
     /* Screen Space Buffer */
     std::vector<Vec3f> color_buffer;
     std::vector<float> depth_buffer;
-    std::vector<Vec3f> position_buffer;
-    std::vector<Vec3f> org_position_buffer;
-    std::vector<Vec3f> normal_buffer;
-    std::vector<Vec3f> org_normal_buffer;
-    std::vector<Vec2f> uv_buffer;
-    std::vector<std::shared_ptr<Materials>> material_buffer;
+    GBuffer g_buffer; // Forward_Pipeline only
+    std::vector<uint32_t> visibility_buffer; // triangle index per pixel, Visibility_Pipeline only
+    HiZBuffer hiz_buffer;
+    /* Light Culling: the screen is split into tiles, and each tile into view distance slices (clusters) */
+    int light_tiles_x = 0;
+    std::vector<float> tile_near, tile_slice_scale; // per tile: nearest view distance, slices per unit distance
+    std::vector<std::vector<uint32_t>> cluster_lights; // per cluster: indices of the lights reaching it
+
+    template <typename FragmentFunc>
+    int RasterizeCells(
+        const TriangleSetup& setup, int min_x, int min_y, int max_x, int max_y, FragmentFunc&& fragment
+    );
+    void triangleNDC(uint32_t tid, Vec3f ndc[3]) const;
+    void triangleAttributes(uint32_t tid, Vec3f normals[3], Vec2f uvs[3]) const;
+    bool ResolveFragment(int idx, uint16_t& material_id, Vec3f& normal, Vec2f& uv) const;
+    void CullLights(const std::vector<Vec3f>& light_centers, const std::vector<float>& light_radii);
+    uint32_t clusterAt(int x, int y, float distance) const {
+        int tile = (y / LIGHT_TILE_SIZE) * light_tiles_x + x / LIGHT_TILE_SIZE;
+        int slice = std::min(static_cast<int>((distance - tile_near[tile]) * tile_slice_scale[tile]), LIGHT_CLUSTER_SLICES - 1);
+        return tile * LIGHT_CLUSTER_SLICES + std::max(slice, 0);
+    }
 public:
     /* Constructors */
     Rasterizer(std::shared_ptr<Camera> cam, std::shared_ptr<Scene> scn):
         camera(cam), scene(scn) {
-            // TODO: Initialize Buffers.
-            triangle_buffer.clear();
-
-            // Initialize the Screen Space Buffer with -
-            color_buffer.resize(camera->getWidth() * camera->getHeight(), Vec3f::Zero());
-            depth_buffer.resize(camera->getWidth() * camera->getHeight(), 1);
-            position_buffer.resize(camera->getWidth() * camera->getHeight(), Vec3f::Zero());
-            normal_buffer.resize(camera->getWidth() * camera->getHeight(), Vec3f::Zero());
-            uv_buffer.resize(camera->getWidth() * camera->getHeight(), -Vec2f::Ones());
-            material_buffer.resize(camera->getWidth() * camera->getHeight(), nullptr);
+            initializeBuffers();
     }
     Rasterizer(const std::string& config_path);
 
     void initializeFromConfig(const Config& config);
+    void initializeBuffers();
+    void clearFrame();
+
+    // Frames
+    void Render();
+    void RenderCameraPath(const CameraPathConfig& path);
 
     // Pass
-    void Pass();
+    void Pass(const std::string& suffix = "");
     void VertexProcessing();
     void FragmentProcessing();
+    int RasterizeTriangle(
+        uint32_t tid, const TriangleSetup& setup, int min_x, int min_y, int max_x, int max_y
+    );
     void FragmentShading();
-    void DisplayToImage();
+    void DisplayToImage(const std::string& suffix = "");
 };
 
 
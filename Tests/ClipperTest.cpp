@@ -0,0 +1,34 @@
+#include "clipper.hpp"
+
+int main() {
+    TriangleClipper clipper(100, 100);
+    ClipVertex polygon[RASTER_MAX_CLIP_VERTICES];
+
+    // Test a triangle inside the frustum: returned unchanged
+    Vec4f inside[3] = {Vec4f(-0.5, -0.5, 0, 1), Vec4f(0.5, -0.5, 0, 1), Vec4f(0, 0.5, 0, 1)};
+    printf("Inside: %d vertices\n", clipper.clip(inside, polygon));
+
+    // Test a triangle behind the camera: rejected
+    Vec4f behind[3] = {Vec4f(-0.5, -0.5, 2, -1), Vec4f(0.5, -0.5, 2, -1), Vec4f(0, 0.5, 2, -1)};
+    printf("Behind: %d vertices\n", clipper.clip(behind, polygon));
+
+    // Test a triangle crossing the near plane (z = w): one vertex behind it, clipped into a quad
+    Vec4f crossing[3] = {Vec4f(-0.5, -0.5, 0, 1), Vec4f(0.5, -0.5, 0, 1), Vec4f(0, 0.5, 3, 1)};
+    int cnt = clipper.clip(crossing, polygon);
+    printf("Crossing: %d vertices\n", cnt);
+    for (int i = 0; i < cnt; i++) {
+        printf("Position: ");
+        utils::printVec(polygon[i].position);
+        printf("Weights: ");
+        utils::printVec(polygon[i].weights);
+    }
+
+    // Test a huge triangle exceeding the guard band: clipped, no vertex beyond the guard band
+    Vec4f huge[3] = {Vec4f(-1e4, -1e4, 0, 1), Vec4f(1e4, -1e4, 0, 1), Vec4f(0, 1e4, 0, 1)};
+    cnt = clipper.clip(huge, polygon);
+    float max_ndc = 0;
+    for (int i = 0; i < cnt; i++) {
+        max_ndc = std::max(max_ndc, polygon[i].position.head<2>().cwiseAbs().maxCoeff() / polygon[i].position.w());
+    }
+    printf("Huge: %d vertices, max |NDC| %f\n", cnt, max_ndc);
+}
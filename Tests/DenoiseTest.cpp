@@ -0,0 +1,35 @@
+#include "denoise.hpp"
+
+int main() {
+    // Two planes side by side at different distances, with a noisy constant radiance on each
+    const int w = 64, h = 64;
+    std::vector<Vec3f> image(w * h), normals(w * h, Vec3f(0, 0, 1));
+    std::vector<float> distances(w * h);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            float value = (x < w / 2) ? 0.2f : 0.8f;
+            float noise = interleavedGradientNoise(x, y) - 0.5f;
+            image[y * w + x] = Vec3f::Constant(value + 0.2f * noise);
+            distances[y * w + x] = (x < w / 2) ? 2.0f : 4.0f;
+        }
+    }
+    // One uncovered pixel
+    distances[0] = INFINITY;
+    image[0] = Vec3f::Zero();
+
+    auto meanError = [&]() {
+        float error = 0;
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                error += std::abs(image[y * w + x].x() - ((x < w / 2) ? 0.2f : 0.8f));
+            }
+        }
+        return error / (w * h);
+    };
+    printf("Mean error before: %f\n", meanError());
+    jointBilateralFilter(image, normals, distances, w, h);
+    // The noise is reduced, and the two planes are not mixed at the edge
+    printf("Mean error after: %f\n", meanError());
+    printf("Edge: %f | %f\n", image[10 * w + w / 2 - 1].x(), image[10 * w + w / 2].x());
+    printf("Uncovered: %f\n", image[0].x());
+}
@@ -0,0 +1,22 @@
+#include "gbuffer.hpp"
+
+int main() {
+    // Test the octahedral normal encoding on both hemispheres
+    float max_error = 0;
+    for (int i = 0; i < 1000; i++) {
+        Vec3f normal = Vec3f::Random().normalized();
+        Vec3f decoded = decodeOctahedral(encodeOctahedral(normal));
+        max_error = std::max(max_error, (decoded - normal).norm());
+    }
+    printf("Octahedral Max Error: %g\n", max_error);
+    printf("Decoded +z: ");
+    utils::printVec(decodeOctahedral(encodeOctahedral(Vec3f(0, 0, 1))));
+    printf("Decoded -z: ");
+    utils::printVec(decodeOctahedral(encodeOctahedral(Vec3f(0, 0, -1))));
+
+    // Test the half float conversion
+    float values[] = {0, 1, -2.5f, 0.333f, 0.99995f, 65504, 1e-6f, 1e5f};
+    for (float value : values) {
+        printf("Half(%g) = %g\n", value, halfToFloat(floatToHalf(value)));
+    }
+}
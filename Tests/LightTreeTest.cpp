@@ -0,0 +1,50 @@
+#include "lighttree.hpp"
+
+int main() {
+    // A 10 x 10 grid of VPLs, as generated by an area light
+    std::vector<Vec3f> positions, intensities;
+    for (int i = 0; i < 10; i++) {
+        for (int j = 0; j < 10; j++) {
+            positions.push_back(Vec3f(i * 0.1f - 0.45f, 2, j * 0.1f - 0.45f));
+            intensities.push_back(Vec3f(0.01f, 0.01f, 0.01f));
+        }
+    }
+    LightTree tree;
+    tree.build(positions, intensities);
+    printf("Nodes: %ld\n", static_cast<long>(tree.getNodes().size()));
+
+    // Diffuse shading of a point below the grid
+    Vec3f position(0.3f, 0, 0.1f), normal(0, 1, 0), reflect_dir(0, 1, 0);
+    auto shade = [&](const Vec3f& vpl_position, const Vec3f& intensity) -> Vec3f {
+        return intensity * std::max((vpl_position - position).normalized().dot(normal), 0.0f);
+    };
+    Vec3f exact = Vec3f::Zero();
+    for (size_t k = 0; k < positions.size(); k++) {
+        exact += shade(positions[k], intensities[k]);
+    }
+    printf("Exact: ");
+    utils::printVec(exact);
+
+    // Test the cuts: a zero tolerance refines up to LIGHTCUT_MAX_SIZE clusters, larger tolerances stop earlier
+    for (float tolerance : {0.0f, 0.01f, 0.05f, 0.2f}) {
+        int evaluations = 0;
+        Vec3f estimate = tree.evaluateCut(position, normal, reflect_dir, 1, tolerance, false,
+            [&](const Vec3f& vpl_position, const Vec3f& intensity) {
+                evaluations++;
+                return shade(vpl_position, intensity);
+            });
+        printf("Tolerance %.2f: %d evaluations, relative error %f\n",
+            tolerance, evaluations, (estimate - exact).norm() / exact.norm());
+    }
+
+    // Test a tree whose bounds are all zero: the cut stops at the root even if the estimate rounds below zero
+    LightTree dark_tree;
+    dark_tree.build(positions, std::vector<Vec3f>(positions.size(), Vec3f::Zero()));
+    int dark_evaluations = 0;
+    Vec3f dark = dark_tree.evaluateCut(position, normal, reflect_dir, 1, 0.05f, false,
+        [&](const Vec3f&, const Vec3f&) {
+            dark_evaluations++;
+            return Vec3f::Constant(-1e-7f);
+        });
+    printf("Zero bounds: %d evaluations, estimate %f\n", dark_evaluations, dark.maxCoeff());
+}
@@ -1,6 +1,23 @@
-#include "object.hpp"
+#include "assetcache.hpp"
 
 int main() {
     std::string file_name = "./assets/Money/2.obj";
     Object bunny(file_name);
-}
\ No newline at end of file
+
+    // The second load reads the mesh cache written by the first one
+    Object cached(file_name);
+    bool same = bunny.getPositions() == cached.getPositions() && bunny.getNormals() == cached.getNormals() &&
+        bunny.getUVs() == cached.getUVs() && bunny.getIndices() == cached.getIndices();
+    printf("Cached mesh matches the source: %s\n", same ? "true" : "false");
+
+    // Instances share the mesh, only a mirroring transform makes a private copy of the indices
+    AssetCache assets;
+    Object instance(assets.getMesh(file_name)), mirrored(assets.getMesh(file_name));
+    instance.localToWorld(utils::generateModelMatrix(Vec3f(1, 0, 0), Vec3f(0, 60, 0), Vec3f(2, 2, 2)));
+    mirrored.localToWorld(utils::generateModelMatrix(Vec3f(-1, 0, 0), Vec3f(0, 0, 0), Vec3f(-1, 1, 1)));
+    printf("Meshes loaded: %ld\n", static_cast<long>(assets.getMeshCount()));
+    // The key comes from the header of the warm mesh cache, without reading the source
+    printf("Mesh key matches the contents: %s\n", assets.getMeshKey(file_name) == hashFileContents(file_name) ? "true" : "false");
+    printf("Instance shares the indices: %s\n", instance.getIndices().data() == instance.getMesh()->indices.data() ? "true" : "false");
+    printf("Mirrored instance shares the indices: %s\n", mirrored.getIndices().data() == mirrored.getMesh()->indices.data() ? "true" : "false");
+}
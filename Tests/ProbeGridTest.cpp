@@ -0,0 +1,39 @@
+#include "probegrid.hpp"
+
+int main() {
+    // A floor of upward facing VPLs below a unit box
+    std::vector<Vec3f> positions, normals, fluxes;
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            positions.push_back(Vec3f((i + 0.5f) / 8, 0, (j + 0.5f) / 8));
+            normals.push_back(Vec3f(0, 1, 0));
+            fluxes.push_back(Vec3f(0.02f, 0.01f, 0.005f));
+        }
+    }
+    Vec3f min_bound(0, 0, 0), max_bound(1, 1, 1);
+    uint64_t key = IrradianceProbeGrid::computeKey("floor below a unit box");
+    IrradianceProbeGrid grid;
+    grid.build(min_bound, max_bound, positions, normals, fluxes, key);
+
+    // Compare with the exact irradiance, a point facing the floor and a point facing away
+    for (Vec3f normal : {Vec3f(0, -1, 0), Vec3f(0, 1, 0), Vec3f(1, 0, 0)}) {
+        Vec3f position(0.5f, 0.5f, 0.5f), exact = Vec3f::Zero();
+        for (size_t k = 0; k < positions.size(); k++) {
+            Vec3f to_vpl = positions[k] - position;
+            float distance_sq = to_vpl.squaredNorm();
+            float cos_receiver = std::max(to_vpl.dot(normal), 0.0f), cos_vpl = std::max(-to_vpl.dot(normals[k]), 0.0f);
+            exact += fluxes[k] * (cos_receiver * cos_vpl / (distance_sq * distance_sq * static_cast<float>(M_PI)));
+        }
+        printf("Normal (%.0f, %.0f, %.0f): probe %f, exact %f\n", normal.x(), normal.y(), normal.z(),
+            grid.evalIrradiance(position, normal).x(), exact.x());
+    }
+
+    // Round trip through a file, a different key must be rejected
+    grid.save("ProbeGridTest.bin");
+    IrradianceProbeGrid loaded;
+    printf("Load with a wrong key: %d\n", loaded.load("ProbeGridTest.bin", key + 1));
+    printf("Load with the right key: %d\n", loaded.load("ProbeGridTest.bin", key));
+    Vec3f position(0.3f, 0.7f, 0.2f), normal = Vec3f(1, -1, 0).normalized();
+    printf("Difference after loading: %f\n",
+        (loaded.evalIrradiance(position, normal) - grid.evalIrradiance(position, normal)).norm());
+}
@@ -0,0 +1,36 @@
+#include "rastercore.hpp"
+
+int main() {
+    const int w = 64, h = 64;
+    TriangleClipper clipper(w, h);
+    // Two triangles, the second one crosses the near plane (z = w) and is clipped into a quad
+    Vec4f triangles[2][3] = {
+        {Vec4f(-0.8, -0.8, 0, 1), Vec4f(0.8, -0.6, 0.2, 1), Vec4f(0, 0.9, -0.4, 1)},
+        {Vec4f(-0.5, -0.5, 0, 1), Vec4f(0.5, -0.5, 0, 1), Vec4f(0, 0.5, 3, 1)}
+    };
+
+    // Rasterize the same triangles with the depth-only and the depth plus id variants
+    std::vector<float> depth_only(w * h, 1), depth_id(w * h, 1);
+    std::vector<uint32_t> ids(w * h, RASTER_INVALID_ID);
+    for (uint32_t t = 0; t < 2; t++) {
+        int cnt = clipTriangle(clipper, triangles[t], [&](const ClipVertex* const corners[3], const Vec3f ndc[3]) {
+            TriangleSetup setup;
+            if (!setup.setup(ndc[0], ndc[1], ndc[2], w, h)) {
+                return;
+            }
+            rasterizeTriangle(setup, setup.min_x, setup.min_y, setup.max_x, setup.max_y,
+                depth_only.data(), w, 0, DepthOnlyAttributes());
+            rasterizeTriangle(setup, setup.min_x, setup.min_y, setup.max_x, setup.max_y,
+                depth_id.data(), w, 0, DepthIdAttributes{ids.data(), w, t});
+        });
+        printf("Triangle %u: %d vertices after clipping\n", t, cnt);
+    }
+
+    // Both variants write the same depths, and an id exactly where a depth was written
+    int mismatch = 0, covered = 0;
+    for (int i = 0; i < w * h; i++) {
+        mismatch += depth_only[i] != depth_id[i] || (depth_id[i] < 1) != (ids[i] != RASTER_INVALID_ID);
+        covered += ids[i] != RASTER_INVALID_ID;
+    }
+    printf("Covered: %d pixels, mismatches: %d\n", covered, mismatch);
+}
@@ -0,0 +1,67 @@
+#include "rastercore.hpp"
+#include <chrono>
+#include <random>
+
+/**
+ * @brief 用指定内核光栅化所有三角形若干遍，取最快的一遍以减小计时噪声。
+ * @return 每秒处理的片元数（深度测试之前被覆盖的像素）。
+ */
+template <typename Kernel>
+static double measure(const std::vector<TriangleSetup>& triangles, int w, int h, Kernel&& kernel) {
+    std::vector<float> depth(w * h);
+    double best = 0;
+    for (int pass = 0; pass < 7; pass++) {
+        std::fill(depth.begin(), depth.end(), 1.0f);
+        int64_t covered = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const TriangleSetup& tri : triangles) {
+            covered += kernel(tri, depth.data());
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, covered / seconds);
+    }
+    return best;
+}
+
+int main() {
+    if (!rasterUseAVX2()) {
+        printf("AVX2 is not available, only the scalar kernel can be measured\n");
+    }
+    const int w = 1024, h = 1024;
+    std::vector<uint32_t> ids(w * h);
+    // Random triangles whose vertices lie within size pixels of a random center
+    for (float size : {4.0f, 16.0f, 64.0f, 256.0f}) {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> center(-1, 1), offset(-size / w, size / w), depth(-1, 1);
+        std::vector<TriangleSetup> triangles;
+        while (triangles.size() < 20000) {
+            Vec3f c(center(rng), center(rng), 0);
+            TriangleSetup tri;
+            if (tri.setup(
+                c + Vec3f(offset(rng), offset(rng), depth(rng)), c + Vec3f(offset(rng), offset(rng), depth(rng)),
+                c + Vec3f(offset(rng), offset(rng), depth(rng)), w, h
+            )) {
+                triangles.push_back(tri);
+            }
+        }
+
+        // Depth only (shadow maps) and depth plus id (visibility buffer)
+        double rates[2][2];
+        for (int simd = 0; simd < 2; simd++) {
+            auto depth_only = [&](const TriangleSetup& tri, float* buffer) {
+                return simd ? rasterizeTriangle(tri, tri.min_x, tri.min_y, tri.max_x, tri.max_y, buffer, w, 0, DepthOnlyAttributes())
+                    : rasterizeTriangleScalar(tri, tri.min_x, tri.min_y, tri.max_x, tri.max_y, buffer, w, 0, DepthOnlyAttributes());
+            };
+            auto depth_id = [&](const TriangleSetup& tri, float* buffer) {
+                DepthIdAttributes attributes{ids.data(), w, 0};
+                return simd ? rasterizeTriangle(tri, tri.min_x, tri.min_y, tri.max_x, tri.max_y, buffer, w, 0, attributes)
+                    : rasterizeTriangleScalar(tri, tri.min_x, tri.min_y, tri.max_x, tri.max_y, buffer, w, 0, attributes);
+            };
+            rates[simd][0] = measure(triangles, w, h, depth_only);
+            rates[simd][1] = measure(triangles, w, h, depth_id);
+        }
+        printf("Triangle size %4.0f px: depth only %7.1f / %7.1f MFrag/s (%.1fx), depth + id %7.1f / %7.1f MFrag/s (%.1fx)\n",
+            size, rates[0][0] / 1e6, rates[1][0] / 1e6, rates[1][0] / rates[0][0],
+            rates[0][1] / 1e6, rates[1][1] / 1e6, rates[1][1] / rates[0][1]);
+    }
+}
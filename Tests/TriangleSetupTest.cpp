@@ -0,0 +1,39 @@
+#include "rasterkernel.hpp"
+
+int main() {
+    // Two triangles sharing the diagonal of a 8x8 square, in both windings
+    int width = 8, height = 8;
+    Vec3f v_0(-1, -1, 0), v_1(1, -1, 0), v_2(1, 1, 0), v_3(-1, 1, 0);
+    TriangleSetup tri_0, tri_1;
+    tri_0.setup(v_0, v_1, v_2, width, height);
+    tri_1.setup(v_0, v_3, v_2, width, height);
+
+    // Test the top-left fill rule: no pixel is covered twice
+    // Each triangle has its own depth buffer, so that the depth test cannot hide a doubly covered pixel
+    std::vector<int> coverage(width * height, 0);
+    std::vector<float> depth_0(width * height, 1), depth_1(width * height, 1);
+    int invalid_weights = 0;
+    auto count = [&](int x, int y, const Vec3f& weights, float) {
+        coverage[y * width + x]++;
+        invalid_weights += weights.minCoeff() < 0 || weights.maxCoeff() > 1;
+    };
+    rasterizeTriangle(tri_0, tri_0.min_x, tri_0.min_y, tri_0.max_x, tri_0.max_y, depth_0.data(), width, 0, count);
+    rasterizeTriangle(tri_1, tri_1.min_x, tri_1.min_y, tri_1.max_x, tri_1.max_y, depth_1.data(), width, 0, count);
+    int overlapped = 0;
+    for (int y = height - 1; y >= 0; y--) {
+        for (int x = 0; x < width; x++) {
+            printf("%d ", coverage[y * width + x]);
+            overlapped += coverage[y * width + x] > 1;
+        }
+        printf("\n");
+    }
+    printf("Overlapped Pixels: %d\n", overlapped);
+    printf("Invalid Weights: %d\n", invalid_weights);
+
+    // Test the interpolation weights inside the triangle
+    std::fill(depth_0.begin(), depth_0.end(), 1);
+    rasterizeTriangle(tri_0, 6, 2, 7, 3, depth_0.data(), width, 0, [](int x, int y, const Vec3f& weights, float depth) {
+        printf("Weights at (%d, %d): ", x, y);
+        utils::printVec(weights);
+    });
+}
@@ -0,0 +1,41 @@
+#include "vertexcache.hpp"
+#include <algorithm>
+
+int main() {
+    // A regular grid of n x n quads, with the triangles in a cache unfriendly (column-major) order
+    const uint32_t n = 64;
+    std::vector<Vertex> vertices;
+    for (uint32_t y = 0; y <= n; y++) {
+        for (uint32_t x = 0; x <= n; x++) {
+            vertices.emplace_back(Vec3f(x, y, 0));
+        }
+    }
+    std::vector<uint32_t> indices;
+    for (uint32_t x = 0; x < n; x++) {
+        for (uint32_t y = 0; y < n; y++) {
+            uint32_t v = y * (n + 1) + x;
+            indices.insert(indices.end(), {v, v + 1, v + n + 2, v, v + n + 2, v + n + 1});
+        }
+    }
+    uint32_t vertex_cnt = vertices.size();
+    std::vector<uint32_t> input = indices;
+
+    // Test the cache optimization: ACMR decreases, the triangles are kept
+    printf("ACMR before: %f\n", computeACMR(indices, vertex_cnt));
+    optimizeVertexCache(indices, vertex_cnt);
+    printf("ACMR after: %f\n", computeACMR(indices, vertex_cnt));
+    std::vector<uint32_t> sorted_input = input, sorted_output = indices;
+    std::sort(sorted_input.begin(), sorted_input.end());
+    std::sort(sorted_output.begin(), sorted_output.end());
+    printf("Same vertex references: %s\n", sorted_input == sorted_output ? "true" : "false");
+
+    // Test the fetch optimization: vertices are referenced in increasing order of first use
+    optimizeVertexFetch(vertices, indices);
+    uint32_t next = 0;
+    bool ordered = true;
+    for (uint32_t idx : indices) {
+        ordered = ordered && idx <= next;
+        next = std::max(next, idx + 1);
+    }
+    printf("Vertices ordered by first use: %s, %ld vertices\n", ordered ? "true" : "false", static_cast<long>(vertices.size()));
+}
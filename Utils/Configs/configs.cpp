@@ -42,6 +42,25 @@ void Config::loadConfig(const std::string& config_file_path) {
     camera_config.fov = loadFloat(raw["Camera"]["Fov"]);
     puts("Camera Config Loaded Successfully!");
 
+    // Load Camera Path Config (Optional)
+    if (raw.contains("CameraPath")) {
+        puts("Loading Camera Path Config...");
+        auto& path = raw["CameraPath"];
+        for (auto& keyframe : path["Keyframes"]) {
+            CameraKeyframe k;
+            k.position = loadVec3f(keyframe["Position"]);
+            k.target = loadVec3f(keyframe["Target"]);
+            camera_path_config.keyframes.push_back(k);
+        }
+        if (path.contains("Frames")) {
+            path["Frames"].get_to(camera_path_config.frames);
+        }
+        if (path.contains("Loop")) {
+            path["Loop"].get_to(camera_path_config.loop);
+        }
+        puts("Camera Path Config Loaded Successfully!");
+    }
+
     // Load Lights Config
     puts("Loading Lights Config...");
     for (auto& light : raw["Lights"]) {
@@ -97,6 +116,52 @@ void Config::loadConfig(const std::string& config_file_path) {
     }
     puts("Objects Config Loaded Successfully!");
 
+    // Load Render Config (Optional)
+    if (raw.contains("Render")) {
+        puts("Loading Render Config...");
+        auto& render = raw["Render"];
+        if (render.contains("Pipeline")) {
+            if (render["Pipeline"] == "Forward") {
+                render_config.pipeline = PipelineType::Forward_Pipeline;
+            }
+            else if (render["Pipeline"] == "Visibility") {
+                render_config.pipeline = PipelineType::Visibility_Pipeline;
+            }
+            else {
+                puts("Unknown Pipeline Type");
+                exit(1);
+            }
+        }
+        if (render.contains("BackFaceCulling")) {
+            render["BackFaceCulling"].get_to(render_config.backface_culling);
+        }
+        if (render.contains("LightFalloff")) {
+            render["LightFalloff"].get_to(render_config.light_falloff);
+        }
+        if (render.contains("LightcutsTolerance")) {
+            render["LightcutsTolerance"].get_to(render_config.lightcuts_tolerance);
+        }
+        if (render.contains("VPLSamples")) {
+            render["VPLSamples"].get_to(render_config.vpl_samples);
+        }
+        if (render.contains("Denoise")) {
+            render["Denoise"].get_to(render_config.denoise);
+        }
+        if (render.contains("IndirectSamples")) {
+            render["IndirectSamples"].get_to(render_config.indirect_samples);
+        }
+        if (render.contains("SoftShadows")) {
+            render["SoftShadows"].get_to(render_config.soft_shadows);
+        }
+        if (render.contains("IrradianceProbes")) {
+            render["IrradianceProbes"].get_to(render_config.irradiance_probes);
+        }
+        if (render.contains("ProbeCache")) {
+            render["ProbeCache"].get_to(render_config.probe_cache);
+        }
+        puts("Render Config Loaded Successfully!");
+    }
+
     raw_file.close();
 
     puts("Config Loaded Successfully!");
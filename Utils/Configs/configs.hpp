@@ -12,6 +12,10 @@ typedef enum LightType {
     Point_Light,
     Area_Light
 } LightType;
+typedef enum PipelineType {
+    Forward_Pipeline,
+    Visibility_Pipeline
+} PipelineType;
 
 struct CameraConfig {
     Vec2i resolution;
@@ -21,6 +25,21 @@ struct CameraConfig {
     float fov;
 };
 
+struct CameraKeyframe {
+    Vec3f position;
+    Vec3f target;
+};
+
+struct CameraPathConfig {
+    // Empty: render a single frame from the Camera config
+    std::vector<CameraKeyframe> keyframes;
+    // Frames rendered along the path, positions and targets are interpolated linearly between keyframes
+    // 0: one frame per keyframe
+    int frames = 0;
+    // Close the path from the last keyframe back to the first, e.g. for turntables
+    bool loop = false;
+};
+
 struct MaterialConfig {
     std::string name;
     MaterialType type;
@@ -47,6 +66,35 @@ struct LightConfig {
     Vec2f size;
 };
 
+struct RenderConfig {
+    // Forward: write every attribute while rasterizing
+    // Visibility: write the triangle index only, resolve attributes while shading
+    PipelineType pipeline = Forward_Pipeline;
+    // Cull triangles facing away from the camera, the front side is given by the vertex normals
+    // Off by default: back faces of open or single-sided meshes are visible and must be drawn
+    bool backface_culling = false;
+    // Attenuate the lights by distance, so that each light only reaches the pixels within its influence radius
+    bool light_falloff = false;
+    // Relative error tolerated when lights with many VPLs are shaded from a cut of their VPL tree
+    // 0: evaluate every VPL
+    float lightcuts_tolerance = 0;
+    // VPLs sampled per light and pixel in stochastic shading, takes precedence over lightcuts
+    // 0: no sampling
+    int vpl_samples = 0;
+    // Filter the noise of stochastic shading with a joint bilateral filter
+    bool denoise = true;
+    // One-bounce indirect light from reflective shadow maps: indirect VPLs gathered per light and pixel
+    // 0: no indirect light
+    int indirect_samples = 0;
+    // Prefiltered soft shadows for area lights, with fractional visibility
+    bool soft_shadows = false;
+    // Shade the indirect light from a grid of irradiance probes instead of gathering the indirect VPLs per pixel
+    bool irradiance_probes = false;
+    // File the probe grid is loaded from when it matches the scene, and saved to otherwise
+    // Empty: always rebuild the grid
+    std::string probe_cache;
+};
+
 class Config {
 public:
     Config() = delete;
@@ -57,9 +105,11 @@ public:
 
     // Sub-Configs
     CameraConfig camera_config;
+    CameraPathConfig camera_path_config;
     std::vector<LightConfig> lights_config;
     std::vector<MaterialConfig> materials_config;
     std::vector<ObjectConfig> objects_config;
+    RenderConfig render_config;
 };
 
 #endif // CONFIGS_HPP_
\ No newline at end of file
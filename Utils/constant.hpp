@@ -10,14 +10,52 @@
 #define REF_RIGHT Vec3f(1, 0, 0)
 // Scene
 #define AMBIENT Vec3f(0.1, 0.1, 0.1)
+#define MATERIAL_NONE 0xFFFF // index of "no material" in the scene material table
+// Mesh
+#define VERTEX_CACHE_SIZE 32 // post-transform cache entries assumed by the vertex cache optimizer
+#define MESH_CACHE_EXTENSION ".hmesh" // suffix of the binary mesh cache written next to each source mesh
 // Light
 #define NUM_SQRT_DIRECT_VPL 10
+#define LIGHT_INFLUENCE_CUTOFF 2e-3f // intensity below which a light with falloff is ignored
+#define LIGHT_TILE_SIZE 16 // side length (pixels) of a light culling tile
+#define LIGHT_CLUSTER_SLICES 4 // view distance slices per light culling tile
+#define LIGHTCUT_MAX_SIZE 32 // upper limit of the clusters evaluated per light and pixel
 // Default Values
 #define DEFAULT_WIDTH 100
 #define DEFAULT_HEIGHT 100
 #define DEFAULT_FAR 20
 #define DEFAULT_FOV 120
+// Rasterizer
+#define RASTER_TILE_SIZE 64 // side length (pixels) of a binning tile
+#define RASTER_SUBPIXEL_BITS 8 // fractional bits of fixed-point screen coordinates
+#define RASTER_FIXED_RANGE 32768 // |screen coordinate| (pixels) representable in fixed point
+#define RASTER_SIMD_MIN_AREA 64 // pixels of a traversal rectangle below which the scalar kernel is used, one 8x8 block
+#define RASTER_HIZ_CELL 8 // side length (pixels) of a hierarchical-z cell, divides RASTER_TILE_SIZE
+#define RASTER_HIZ_REFRESH 32 // triangles rasterized in a tile between hierarchical-z refreshes
+#define RASTER_GUARD_BAND 8192 // pixels beyond each screen edge in which triangles are not clipped
+#define RASTER_MAX_CLIP_VERTICES 8 // a triangle clipped by the near and four guard band planes
+#define RASTER_INVALID_ID 0xFFFFFFFFu // visibility buffer value of pixels not covered by any triangle
+// Denoising
+#define DENOISE_RADIUS 3 // taps on each side of a joint bilateral filter pass
+#define DENOISE_SIGMA_SPATIAL 1.5f // standard deviation (pixels) of the spatial weight
+#define DENOISE_SIGMA_DEPTH 0.02f // standard deviation of the view distance weight, relative to the distance
+#define DENOISE_NORMAL_POWER 32 // exponent of the normal weight, the cosine between the normals, a power of 2
 // Shadow Map
 #define DEFAULT_SHADOW_MAP_RESOLUTION 128
 #define SHADOW_MAP_BIAS 1e-3
+#define SHADOW_MAP_SLOPE_BIAS 1.5f // depth bias in pixels of depth slope, applied while rendering the shadow map
+#define SHADOW_MAP_MAX_SLOPE_BIAS 5e-3f // upper limit of the slope-scaled bias in stored depth
+#define SHADOW_LOOKUP_BATCH 256 // positions per chunk of a batched shadow lookup, whose scratch lives on the stack
+// Soft Shadows
+#define SOFT_SHADOW_MAP_RESOLUTION 64 // shadow map resolution of area lights with soft shadows
+#define SOFT_SHADOW_ESM_EXPONENT 40.0f // exponent (per unit distance) of the exponential shadow map
+#define SOFT_SHADOW_BLUR_RADIUS 1 // taps on each side of the box filter applied to the exponential shadow map
+#define SOFT_SHADOW_MIP_LEVELS 5 // levels of the prefiltered shadow map mip chain
+#define SOFT_SHADOW_BIAS 0.02f // depth bias (distance) of soft shadow lookups
+// Reflective Shadow Map
+#define RSM_INTERLEAVE 4 // side length (pixels) of the interleaved sampling pattern, one indirect VPL set per pattern pixel
+#define RSM_MIN_DISTANCE 0.1f // lower limit of the distance to an indirect VPL, avoids spikes next to the VPLs
+// Irradiance Probes
+#define PROBE_GRID_RESOLUTION 8 // probes along the longest axis of the scene bounds
+#define PROBE_SH_COEFFS 9 // order 2 spherical harmonics per probe and color channel
 #endif // CONSTANT_HPP_
\ No newline at end of file
@@ -28,6 +28,11 @@ using Mat4f = Eigen::Matrix4f;
 using VecXf = Eigen::VectorXf;
 using MatXf = Eigen::MatrixXf;
 
+// Attribute Blocks: one column per vertex
+using Mat2Xf = Eigen::Matrix<float, 2, Eigen::Dynamic>;
+using Mat3Xf = Eigen::Matrix<float, 3, Eigen::Dynamic>;
+using Mat4Xf = Eigen::Matrix<float, 4, Eigen::Dynamic>;
+
 
 
 #endif // CORES_HPP
\ No newline at end of file
@@ -5,6 +5,13 @@
 #include "image.hpp"
 #include <iostream>
 #include <cmath>
+#include <sstream>
+#include <thread>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 
 
 namespace utils {
@@ -100,6 +107,18 @@ namespace utils {
         Mat4f scale_matrix = generateScaleMatrix(scale);
         return translation_matrix * rotation_matrix * scale_matrix;
     }
+
+    // File Function
+    inline std::string temporaryFileName(const std::string& file_name) {
+        // Unique per process and thread, so that concurrent writers of the same file never share a temporary file
+        std::ostringstream name;
+#ifdef _WIN32
+        name << file_name << "." << _getpid() << "." << std::this_thread::get_id() << ".tmp";
+#else
+        name << file_name << "." << getpid() << "." << std::this_thread::get_id() << ".tmp";
+#endif
+        return name.str();
+    }
 };
 
 #endif // UTILS_HPP_
\ No newline at end of file
@@ -18,7 +18,7 @@ int main(int argc, char const *argv[]) {
     Rasterizer rast(config_path);
     
 
-    // Pass the Rasterizer
-    rast.Pass();
+    // Render the frame, or every frame along the camera path
+    rast.Render();
     return 0;
 }
\ No newline at end of file
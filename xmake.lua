@@ -38,6 +38,9 @@ target("Rasterizer")
     -- Object
     add_includedirs("Modules/Object", {public = true})
     add_files("Modules/Object/*.cpp")
+    -- Raster
+    add_includedirs("Modules/Raster", {public = true})
+    add_files("Modules/Raster/*.cpp")
     -- Rasterizer
     add_includedirs("Rasterizer", {public = true})
     add_files("Rasterizer/*.cpp")
@@ -75,16 +78,97 @@ target("HypoxRasterizer")
 --     add_packages(depends, {public = true})
 --     set_targetdir(".")
 
+-- target("TriangleSetupTest")
+--     add_deps("Utils")
+--     set_kind("binary")
+--     add_includedirs("Modules/Raster/")
+--     add_files("Modules/Raster/*.cpp")
+--     add_files("Tests/TriangleSetupTest.cpp")
+--     add_packages(depends, {public = true})
+--     set_targetdir(".")
+
+-- target("GBufferTest")
+--     add_deps("Utils")
+--     set_kind("binary")
+--     add_includedirs("Modules/Raster/")
+--     add_files("Modules/Raster/gbuffer.cpp")
+--     add_files("Tests/GBufferTest.cpp")
+--     add_packages(depends, {public = true})
+--     set_targetdir(".")
+
+-- target("ClipperTest")
+--     add_deps("Utils")
+--     set_kind("binary")
+--     add_includedirs("Modules/Raster/")
+--     add_files("Modules/Raster/clipper.cpp")
+--     add_files("Tests/ClipperTest.cpp")
+--     add_packages(depends, {public = true})
+--     set_targetdir(".")
+
+-- target("DenoiseTest")
+--     add_deps("Utils")
+--     set_kind("binary")
+--     add_includedirs("Modules/Raster/")
+--     add_files("Modules/Raster/denoise.cpp")
+--     add_files("Tests/DenoiseTest.cpp")
+--     add_packages(depends, {public = true})
+--     set_targetdir(".")
+
 -- target("ObjectTest")
 --     add_deps("Utils")
 --     set_kind("binary")
 --     add_includedirs("Modules/Object/")
 --     add_files("Modules/Object/geometry.cpp")
---     add_files("Modules/Object/object.cpp")
+--     add_files("Modules/Object/object.cpp", "Modules/Object/vertexcache.cpp", "Modules/Object/meshcache.cpp", "Modules/Object/assetcache.cpp")
 --     add_files("Tests/ObjectTest.cpp")
 --     add_packages(depends, {public = true})
 --     set_targetdir(".")
 
+-- target("VertexCacheTest")
+--     add_deps("Utils")
+--     set_kind("binary")
+--     add_includedirs("Modules/Object/")
+--     add_files("Modules/Object/vertexcache.cpp")
+--     add_files("Tests/VertexCacheTest.cpp")
+--     add_packages(depends, {public = true})
+--     set_targetdir(".")
+
+-- target("LightTreeTest")
+--     add_deps("Utils")
+--     set_kind("binary")
+--     add_includedirs("Modules/Light/")
+--     add_files("Modules/Light/lighttree.cpp")
+--     add_files("Tests/LightTreeTest.cpp")
+--     add_packages(depends, {public = true})
+--     set_targetdir(".")
+
+-- target("ProbeGridTest")
+--     add_deps("Utils")
+--     set_kind("binary")
+--     add_includedirs("Modules/Light/")
+--     add_files("Modules/Light/probegrid.cpp")
+--     add_files("Tests/ProbeGridTest.cpp")
+--     add_packages(depends, {public = true})
+--     set_targetdir(".")
+
+-- target("RasterCoreTest")
+--     add_deps("Utils")
+--     set_kind("binary")
+--     add_includedirs("Modules/Raster/")
+--     add_files("Modules/Raster/clipper.cpp", "Modules/Raster/trianglesetup.cpp", "Modules/Raster/rasterkernel.cpp", "Modules/Raster/gbuffer.cpp")
+--     add_files("Tests/RasterCoreTest.cpp")
+--     add_packages(depends, {public = true})
+--     set_targetdir(".")
+
+-- target("RasterKernelBenchmark")
+--     add_deps("Utils")
+--     set_kind("binary")
+--     add_includedirs("Modules/Raster/")
+--     add_files("Modules/Raster/clipper.cpp", "Modules/Raster/trianglesetup.cpp", "Modules/Raster/rasterkernel.cpp", "Modules/Raster/gbuffer.cpp")
+--     add_files("Tests/RasterKernelBenchmark.cpp")
+--     add_packages(depends, {public = true})
+--     set_targetdir(".")
+
 -- target("TriangleTestpy")
 --     add_deps("Utils")
 --     set_kind("binary")